@@ -1,30 +1,23 @@
 // (C) Copyright Shou Hao Ho   2018
 // Distributed under the MIT Software License (See accompanying LICENSE file)
 
-#include <Eigen/Dense>
-#include <boost/range/combine.hpp>
-#include <boost/range/adaptors.hpp>
+#include <Eigen/Sparse>
 #include <numeric>
 
+#include "perf_counters.h"
 #include "placement.h"
 #include "plan.h"
+#include "stats.h"
+#include "trace.h"
 
 namespace Utils {
 
     namespace impl {
 
-        Plan::coord get_pin_coord(const Plan &plan, const Atom &atom, const Plan::plan_region &region) {
-            Plan::coord nearest_coord;
+        constexpr double anchor_weight = 1e-6;
 
-            if (auto c = plan.get_coord(static_cast<const IPin&>(atom))) {
-                nearest_coord = *c;
-            }
-            else if (auto c = plan.get_coord(static_cast<const OPin&>(atom))) {
-                nearest_coord = *c;
-            }
-            else {
-                nearest_coord = plan.get_coord(atom);
-            }
+        Plan::coord get_pin_coord(const Plan &plan, FlatNetlist::id_type atom, const Plan::plan_region &region) {
+            Plan::coord nearest_coord = plan.get_coord(atom);
 
             if (nearest_coord.x < region.first.begin) {
                 nearest_coord.x = region.first.begin;
@@ -43,107 +36,193 @@ namespace Utils {
             return nearest_coord;
         }
 
-    }
+        template <typename Preconditioner>
+        Eigen::MatrixX2d solve_cg(const Eigen::SparseMatrix<double> &A, const Eigen::MatrixX2d &b,
+            const Eigen::MatrixX2d &guess, const qp_options &options)
+        {
+            Eigen::ConjugateGradient<Eigen::SparseMatrix<double>, Eigen::Lower | Eigen::Upper, Preconditioner> solver;
+            solver.setTolerance(options.tolerance);
+            if (options.max_iterations > 0) solver.setMaxIterations(options.max_iterations);
+
+            solver.compute(A);
+            RUNTIME_ASSERT(solver.info() == Eigen::Success);
+            return solver.solveWithGuess(b, guess);
+        }
 
-    void dump_plan(const Plan &plan, std::ostream &os) {
-        for (const auto &entry : plan.board()) {
-            os << "(" << entry.second.x << "," << entry.second.y << ")\n";
+        Eigen::MatrixX2d solve(const Eigen::SparseMatrix<double> &A, const Eigen::MatrixX2d &b,
+            const Eigen::MatrixX2d &guess, const qp_options &options)
+        {
+            PLACER_PERF_STAGE(qp_solve);
+            switch (options.solver) {
+            case qp_solver::conjugate_gradient_jacobi:
+                return solve_cg<Eigen::DiagonalPreconditioner<double>>(A, b, guess, options);
+            case qp_solver::conjugate_gradient_ichol:
+                return solve_cg<Eigen::IncompleteCholesky<double>>(A, b, guess, options);
+            default:
+                Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> solver{ A };
+                RUNTIME_ASSERT(solver.info() == Eigen::Success);
+                return solver.solve(b);
+            }
         }
-    }
 
-    Plan quadratic_placement(std::size_t width, std::size_t height, const Netlist &netlist, int num_iter,
-        Plan::partitioning_method method, std::size_t expected_phases, metric_consumer* met) {
-        double pin_weight_factor = 1.0 / expected_phases;
+        struct partition_index {
+            std::vector<FlatNetlist::id_type> partition_of;
+            std::vector<FlatNetlist::id_type> local_index;
+        };
+
+        void index_partition(const Plan &plan, std::size_t partition_no, partition_index &index) {
+            const FlatNetlist &flat = plan.get_flat_netlist();
+            FlatNetlist::id_type local = 0;
+            for (const Atom* atom : plan.partitions()[partition_no]) {
+                FlatNetlist::id_type id = flat.atom_id(*atom);
+                index.partition_of[id] = static_cast<FlatNetlist::id_type>(partition_no);
+                index.local_index[id] = local++;
+            }
+        }
 
-        Plan plan{ width, height, netlist };
-        auto has_fanin = [](const IPort &iport) { return iport.has_fanin(); };
+        std::int64_t average_ipin_fanout(const Netlist &netlist) {
+            std::int64_t total = std::accumulate(netlist.begin_ipins(), netlist.end_ipins(), 0,
+                [](std::int64_t prev, const IPin &ipin) { return prev + ipin.get_oport().size(); });
+            return total / netlist.num_ipins();
+        }
 
-        std::int64_t avg_conn_per_ipin = std::accumulate(netlist.begin_ipins(), netlist.end_ipins(), 0,
-            [](std::int64_t prev, const IPin &ipin) { return prev + ipin.get_oport().size(); });
-        avg_conn_per_ipin /= netlist.num_ipins();
+        void assemble_partition(const Plan &plan, const partition_index &index, std::size_t partition_no,
+            const Plan::plan_region &region, double pin_weight_factor, std::int64_t avg_conn_per_ipin,
+            Eigen::SparseMatrix<double> &A, Eigen::MatrixX2d &b)
+        {
+            PLACER_PERF_STAGE(qp_assemble);
+            const FlatNetlist &flat = plan.get_flat_netlist();
+            const Plan::Partition &partition = plan.partitions()[partition_no];
+
+            std::vector<Eigen::Triplet<double>> triplets;
+            triplets.reserve(partition.size() * 8);
+
+            for (std::size_t x = 0; x < partition.size(); ++x) {
+                const Atom* atom = partition[x];
+                FlatNetlist::id_type atom_id = flat.atom_id(*atom);
+
+                double diag = 0.0;
+                auto register_target = [&](double inv_weight, FlatNetlist::id_type target) {
+                    if (target == atom_id) return;
+                    diag += inv_weight;
+
+                    if (index.partition_of[target] == partition_no) {
+                        std::size_t y = index.local_index[target];
+                        RUNTIME_ASSERT(x != y);
+                        triplets.emplace_back(x, y, -inv_weight);
+                    }
+                    else {
+                        auto coord = get_pin_coord(plan, target, region);
+                        inv_weight *= pin_weight_factor;
+                        if (flat.is_opin(target)) inv_weight *= avg_conn_per_ipin;
 
-        bool split_vertically = true;
-        for (int i = 0; i < num_iter; ++i) {
-            if (i > 0) {
-                plan.recursive_partition(split_vertically, method);
-                split_vertically = !split_vertically;
-            }
+                        b(x, 0) += inv_weight * coord.x;
+                        b(x, 1) += inv_weight * coord.y;
+                    }
+                };
 
-            std::vector<std::vector<Plan::coord>> solutions;
-            for (const auto &entry : boost::combine(plan.partitions(), plan.bounds())) {
-                const Plan::Partition &partition = boost::get<0>(entry);
-                const Plan::plan_region &region = boost::get<1>(entry);
-                if (partition.size() == 0) continue;
+                for (FlatNetlist::id_type net : flat.fanin_nets(atom_id)) {
+                    register_target(flat.net_weight(net), flat.net_driver(net));
+                }
 
-                std::unordered_map<const Atom*, std::size_t> atom_to_index;
-                std::size_t i = 0;
-                for (const Atom* atom : partition) {
-                    atom_to_index[atom] = i++;
+                for (FlatNetlist::id_type net : flat.driven_nets(atom_id)) {
+                    double inv_weight = flat.net_weight(net);
+                    for (FlatNetlist::id_type target : flat.net_sinks(net)) {
+                        register_target(inv_weight, target);
+                    }
                 }
 
-                Eigen::MatrixXd A = Eigen::MatrixXd::Zero(partition.size(), partition.size());
+                // Weak anchor to the current coordinate, keeps floating atoms from making A singular
+                const Plan::coord &curr = plan.get_coord(*atom);
+                diag += anchor_weight;
+                b(x, 0) += anchor_weight * curr.x;
+                b(x, 1) += anchor_weight * curr.y;
 
-                Eigen::VectorXd b_x = Eigen::VectorXd::Zero(partition.size());
-                Eigen::VectorXd b_y = Eigen::VectorXd::Zero(partition.size());
+                triplets.emplace_back(x, x, diag);
+            }
 
-                for (std::size_t x = 0; x < partition.size(); ++x) {
-                    const Atom* atom = partition[x];
+            A.setFromTriplets(triplets.begin(), triplets.end());
+        }
 
-                    auto register_target = [&](double inv_weight, const Atom &target_atom) {
-                        if (&target_atom == atom) return;
-                        A(x, x) += inv_weight;
+        std::vector<Plan::coord> solve_partition(const Plan &plan, const partition_index &index, std::size_t partition_no,
+            const Plan::plan_region &region, double pin_weight_factor, std::int64_t avg_conn_per_ipin, const qp_options &options)
+        {
+            const Plan::Partition &partition = plan.partitions()[partition_no];
 
-                        auto idx_iter = atom_to_index.find(&target_atom);
-                        if (idx_iter != atom_to_index.end()) {
-                            std::size_t y = idx_iter->second;
-                            RUNTIME_ASSERT(x != y);
-                            A(x, y) += -inv_weight;
-                        }
-                        else {
-                            auto coord = impl::get_pin_coord(plan, target_atom, region);
-                            inv_weight *= pin_weight_factor;
-                            if (target_atom.get_type() == Atom::type::OPIN) inv_weight *= avg_conn_per_ipin;
+            Eigen::SparseMatrix<double> A(partition.size(), partition.size());
+            Eigen::MatrixX2d b = Eigen::MatrixX2d::Zero(partition.size(), 2);
+            assemble_partition(plan, index, partition_no, region, pin_weight_factor, avg_conn_per_ipin, A, b);
 
-                            b_x(x) += inv_weight * coord.x;
-                            b_y(x) += inv_weight * coord.y;
-                        }
-                    };
+            Eigen::MatrixX2d guess(partition.size(), 2);
+            for (std::size_t j = 0; j < partition.size(); ++j) {
+                const Plan::coord &c = plan.get_coord(*partition[j]);
+                guess(j, 0) = c.x;
+                guess(j, 1) = c.y;
+            }
 
-                    for (const IPort &iport : atom->inputs() | boost::adaptors::filtered(has_fanin)) {
-                        const OPort* target_oport = iport.fanin();
-                        double inv_weight = 1.0 / target_oport->size();
-                        const Atom &target_atom = target_oport->get_atom();
+            Eigen::MatrixX2d X = solve(A, b, guess, options);
 
-                        register_target(inv_weight, target_atom);
-                    }
+            std::vector<Plan::coord> sol(partition.size());
+            for (std::size_t j = 0; j < partition.size(); ++j) {
+                sol[j] = Plan::coord{ X(j, 0), X(j, 1) };
+            }
 
-                    for (const OPort &oport : atom->outputs()) {
-                        if (oport.empty()) continue;
-                        double inv_weight = 1.0 / oport.size();
+            return sol;
+        }
 
-                        for (const IPort* target_iport : oport) {
-                            const Atom &target_atom = target_iport->get_atom();
+    }
 
-                            register_target(inv_weight, target_atom);
-                        }
-                    }
-                }
+    void dump_plan(const Plan &plan, std::ostream &os) {
+        for (const auto &entry : plan.board()) {
+            os << "(" << entry.second.x << "," << entry.second.y << ")\n";
+        }
+    }
+
+    Plan quadratic_placement(std::size_t width, std::size_t height, const Netlist &netlist, int num_iter,
+        Plan::partitioning_method method, std::size_t expected_phases, metric_consumer* met, const qp_options &options) {
+        PLACER_STATS_REPORT_SCOPE(quadratic_placement);
+        PLACER_TRACE_SPAN("quadratic_placement");
+        double pin_weight_factor = 1.0 / expected_phases;
 
-                A.ldlt().solveInPlace(b_x);
-                A.ldlt().solveInPlace(b_y);
+        Plan plan{ width, height, netlist };
+        thread_pool pool{ options.num_threads };
 
-                std::vector<Plan::coord> sol(partition.size());
-                for (std::size_t j = 0; j < partition.size(); ++j) {
-                    sol[j] = Plan::coord{ b_x(j), b_y(j) };
-                }
+        const FlatNetlist &flat = plan.get_flat_netlist();
+        impl::partition_index index{ std::vector<FlatNetlist::id_type>(flat.num_atoms(), FlatNetlist::invalid_id),
+                                     std::vector<FlatNetlist::id_type>(flat.num_atoms(), FlatNetlist::invalid_id) };
 
-                solutions.emplace_back(std::move(sol));
-            }
+        std::int64_t avg_conn_per_ipin = impl::average_ipin_fanout(netlist);
 
-            for (std::size_t i = 0; i < solutions.size(); ++i) {
-                plan.assign_coords(plan.partitions()[i], solutions[i], plan.bounds()[i]);
+        bool split_vertically = true;
+        for (int i = 0; i < num_iter; ++i) {
+            PLACER_STATS_TIMER(qp_level);
+            PLACER_TRACE_SPAN_ARG("qp_level", "level", i);
+            if (i > 0) {
+                PLACER_STATS_TIMER(qp_partition);
+                plan.recursive_partition(split_vertically, method, pool);
+                split_vertically = !split_vertically;
             }
 
+            // Every partition of a level anchors to the previous level's coordinates, so all solves
+            // must finish before any of them is assigned.
+            std::vector<std::vector<Plan::coord>> solutions(plan.partitions().size());
+            pool.parallel_for(0, solutions.size(), [&](std::size_t j) { impl::index_partition(plan, j, index); });
+
+            pool.parallel_for(0, solutions.size(), [&](std::size_t j) {
+                if (plan.partitions()[j].size() == 0) return;
+                PLACER_STATS_TIMER(qp_solve);
+                PLACER_TRACE_SPAN_ARG("qp_solve", "atoms", plan.partitions()[j].size());
+                PLACER_STATS_ADD(qp_partitions, 1);
+                PLACER_STATS_ADD(qp_atoms, plan.partitions()[j].size());
+                solutions[j] = impl::solve_partition(plan, index, j, plan.bounds()[j],
+                    pin_weight_factor, avg_conn_per_ipin, options);
+            });
+
+            PLACER_TRACE_SPAN("qp_assign_coords");
+            pool.parallel_for(0, solutions.size(), [&](std::size_t j) {
+                plan.assign_coords(plan.partitions()[j], solutions[j], plan.bounds()[j]);
+            });
+
             if (met != nullptr) {
                 met->snapshot() << "ss " << i << " (" << width << "," << height << "):\n";
                 dump_plan(plan, met->snapshot());
@@ -153,4 +232,23 @@ namespace Utils {
         return plan;
     }
 
+    std::size_t assemble_qp_systems(const Plan &plan, std::size_t expected_phases) {
+        const FlatNetlist &flat = plan.get_flat_netlist();
+        impl::partition_index index{ std::vector<FlatNetlist::id_type>(flat.num_atoms(), FlatNetlist::invalid_id),
+                                     std::vector<FlatNetlist::id_type>(flat.num_atoms(), FlatNetlist::invalid_id) };
+        for (std::size_t j = 0; j < plan.partitions().size(); ++j) impl::index_partition(plan, j, index);
+        std::int64_t avg_conn_per_ipin = impl::average_ipin_fanout(plan.get_netlist());
+
+        std::size_t num_nonzeros = 0;
+        for (std::size_t j = 0; j < plan.partitions().size(); ++j) {
+            std::size_t size = plan.partitions()[j].size();
+            if (size == 0) continue;
+            Eigen::SparseMatrix<double> A(size, size);
+            Eigen::MatrixX2d b = Eigen::MatrixX2d::Zero(size, 2);
+            impl::assemble_partition(plan, index, j, plan.bounds()[j], 1.0 / expected_phases, avg_conn_per_ipin, A, b);
+            num_nonzeros += A.nonZeros();
+        }
+        return num_nonzeros;
+    }
+
 }
\ No newline at end of file
@@ -0,0 +1,103 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Utils {
+
+    // Monotonic arena. Memory is carved from large blocks and only handed back to the system when
+    // the arena is destroyed. Blocks whose size is a power of two can be released into a per-size
+    // free list and are reused by the next allocation of the same size, which keeps lists that grow
+    // by doubling from leaking their old storage.
+    class arena {
+
+    public:
+
+        explicit arena(std::size_t block_size = std::size_t(1) << 20)
+            :m_block_size{ block_size },
+            m_cur{ nullptr },
+            m_end{ nullptr },
+            m_free{}
+        {}
+
+        arena(const arena&) = delete;
+        arena &operator=(const arena&) = delete;
+
+        void reserve(std::size_t num_bytes) {
+            if (static_cast<std::size_t>(m_end - m_cur) < num_bytes) new_block(num_bytes);
+        }
+
+        template <typename T>
+        T* allocate(std::size_t n) {
+            if (n == 0) return nullptr;
+            std::size_t num_bytes = n * sizeof(T);
+            std::size_t size_class = free_class(num_bytes);
+            if (size_class < m_free.size() && m_free[size_class] != nullptr) {
+                free_block* block = m_free[size_class];
+                m_free[size_class] = block->next;
+                return reinterpret_cast<T*>(block);
+            }
+            return static_cast<T*>(allocate_bytes(num_bytes, alignof(T)));
+        }
+
+        template <typename T>
+        void release(T* ptr, std::size_t n) {
+            std::size_t size_class = free_class(n * sizeof(T));
+            if (ptr == nullptr || size_class >= m_free.size()) return;
+            free_block* block = reinterpret_cast<free_block*>(ptr);
+            block->next = m_free[size_class];
+            m_free[size_class] = block;
+        }
+
+        inline std::size_t num_blocks() const { return m_blocks.size(); }
+
+    private:
+
+        struct free_block {
+            free_block* next;
+        };
+
+        static constexpr std::size_t num_free_classes = 32;
+
+        static inline std::size_t free_class(std::size_t num_bytes) {
+            if (num_bytes < sizeof(free_block) || (num_bytes & (num_bytes - 1)) != 0) return num_free_classes;
+            std::size_t size_class = 0;
+            while ((std::size_t(1) << size_class) < num_bytes) ++size_class;
+            return size_class;
+        }
+
+        void* allocate_bytes(std::size_t num_bytes, std::size_t alignment) {
+            std::uintptr_t cur = reinterpret_cast<std::uintptr_t>(m_cur);
+            std::uintptr_t aligned = (cur + alignment - 1) & ~(static_cast<std::uintptr_t>(alignment) - 1);
+            if (m_cur == nullptr || aligned + num_bytes > reinterpret_cast<std::uintptr_t>(m_end)) {
+                new_block(num_bytes + alignment);
+                cur = reinterpret_cast<std::uintptr_t>(m_cur);
+                aligned = (cur + alignment - 1) & ~(static_cast<std::uintptr_t>(alignment) - 1);
+            }
+            m_cur = reinterpret_cast<char*>(aligned + num_bytes);
+            return reinterpret_cast<void*>(aligned);
+        }
+
+        void new_block(std::size_t min_bytes) {
+            std::size_t num_bytes = std::max(m_block_size, min_bytes);
+            m_blocks.emplace_back(new char[num_bytes]);
+            m_cur = m_blocks.back().get();
+            m_end = m_cur + num_bytes;
+        }
+
+        std::size_t m_block_size;
+        char* m_cur;
+        char* m_end;
+        std::vector<std::unique_ptr<char[]>> m_blocks;
+        std::array<free_block*, num_free_classes> m_free;
+
+    };
+
+}
\ No newline at end of file
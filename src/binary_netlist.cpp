@@ -0,0 +1,179 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#include "binary_netlist.h"
+#include "flat_netlist.h"
+
+namespace Utils {
+
+    namespace impl {
+
+        constexpr char binary_netlist_magic[4] = { 'P', 'L', 'N', 'L' };
+        constexpr std::uint32_t binary_netlist_byte_order = 0x01020304;
+
+        Atom &atom_by_id(Netlist &netlist, std::size_t id) {
+            if (id < netlist.num_luts()) return get<Netlist::LUT>(netlist, id);
+            id -= netlist.num_luts();
+            if (id < netlist.num_ffs()) return get<Netlist::FF>(netlist, id);
+            id -= netlist.num_ffs();
+            if (id < netlist.num_ipins()) return get<IPin>(netlist, id);
+            return get<OPin>(netlist, id - netlist.num_ipins());
+        }
+
+        std::size_t port_index(const IPort &iport) {
+            return &iport - &*iport.get_atom().begin_inputs();
+        }
+
+        std::size_t port_index(const OPort &oport) {
+            return &oport - &*oport.get_atom().begin_outputs();
+        }
+
+        template <typename T>
+        void write_array(std::ofstream &os, const std::vector<T> &values) {
+            os.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+        }
+
+    }
+
+    constexpr std::uint32_t binary_netlist_view::version;
+
+    binary_netlist_view::binary_netlist_view(const std::string &filepath)
+        :m_file{ filepath }
+    {
+        const char* base = m_file.data();
+        RUNTIME_ASSERT(m_file.size() >= sizeof(binary_netlist_header));
+
+        m_header = reinterpret_cast<const binary_netlist_header*>(base);
+        RUNTIME_ASSERT(std::memcmp(m_header->magic, impl::binary_netlist_magic, sizeof(m_header->magic)) == 0);
+        RUNTIME_ASSERT(m_header->version == version);
+        RUNTIME_ASSERT(m_header->byte_order == impl::binary_netlist_byte_order);
+
+        // The header counts are untrusted until each section is known to fit in what is left of
+        // the file; the checks divide rather than multiply so no count can overflow them.
+        const binary_netlist_header &h = *m_header;
+        for (std::uint64_t count : { h.num_luts, h.num_ffs, h.num_ipins, h.num_opins, h.num_nets }) {
+            RUNTIME_ASSERT(count < m_file.size() / sizeof(std::uint64_t));
+        }
+        RUNTIME_ASSERT(num_atoms() <= std::numeric_limits<std::uint32_t>::max());
+        RUNTIME_ASSERT(h.max_fanouts <= std::numeric_limits<std::uint32_t>::max());
+
+        // Every port of every cell is allocated up front, so the port counts are held to one port
+        // per byte of the file. A valid file already spends a whole phase word on each cell.
+        std::uint64_t num_cells = std::max<std::uint64_t>(1, h.num_luts + h.num_ffs);
+        for (std::uint64_t max_ports : { h.max_inputs, h.max_outputs }) {
+            RUNTIME_ASSERT(max_ports <= m_file.size() / num_cells);
+        }
+
+        std::size_t offset = sizeof(binary_netlist_header);
+        auto section = [&](std::uint64_t count, std::size_t size) {
+            RUNTIME_ASSERT(count <= (m_file.size() - offset) / size);
+            const char* begin = base + offset;
+            offset += count * size;
+            return begin;
+        };
+
+        m_phases = reinterpret_cast<const std::uint64_t*>(section(num_atoms(), sizeof(std::uint64_t)));
+        m_net_offsets = reinterpret_cast<const std::uint64_t*>(section(h.num_nets + 1, sizeof(std::uint64_t)));
+        m_drivers = reinterpret_cast<const binary_pin*>(section(h.num_nets, sizeof(binary_pin)));
+        m_sinks = reinterpret_cast<const binary_pin*>(section(h.num_sinks, sizeof(binary_pin)));
+        RUNTIME_ASSERT(offset == m_file.size());
+
+        RUNTIME_ASSERT(m_net_offsets[0] == 0 && m_net_offsets[h.num_nets] == h.num_sinks);
+        for (std::size_t net = 0; net < h.num_nets; ++net) {
+            RUNTIME_ASSERT(m_net_offsets[net] <= m_net_offsets[net + 1]);
+        }
+    }
+
+    Netlist binary_netlist_view::build() const {
+        const binary_netlist_header &h = *m_header;
+        Netlist netlist{ h.num_ipins, h.num_opins, h.num_luts, h.num_ffs, h.max_inputs, h.max_outputs, h.max_fanouts };
+
+        for (std::size_t id = 0; id < num_atoms(); ++id) {
+            impl::atom_by_id(netlist, id).set_phase(m_phases[id]);
+        }
+
+        for (std::size_t net = 0; net < num_nets(); ++net) {
+            const binary_pin &driver = m_drivers[net];
+            RUNTIME_ASSERT(driver.atom < num_atoms());
+            OPort &oport = impl::atom_by_id(netlist, driver.atom).get_oport(driver.port);
+            oport.reserve(m_net_offsets[net + 1] - m_net_offsets[net]);
+
+            for (const binary_pin &sink : net_sinks(net)) {
+                RUNTIME_ASSERT(sink.atom < num_atoms());
+                connect(oport, impl::atom_by_id(netlist, sink.atom).get_iport(sink.port));
+            }
+        }
+
+        return netlist;
+    }
+
+    void save_binary_netlist(const Netlist &netlist, const std::string &filepath) {
+        FlatNetlist flat{ netlist };
+
+        binary_netlist_header header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, impl::binary_netlist_magic, sizeof(header.magic));
+        header.version = binary_netlist_view::version;
+        header.byte_order = impl::binary_netlist_byte_order;
+        header.num_ipins = netlist.num_ipins();
+        header.num_opins = netlist.num_opins();
+        header.num_luts = netlist.num_luts();
+        header.num_ffs = netlist.num_ffs();
+
+        RUNTIME_ASSERT(netlist.num_luts() + netlist.num_ffs() > 0);
+        const Atom &cell = netlist.num_luts() > 0 ? get<Netlist::LUT>(netlist, 0) : get<Netlist::FF>(netlist, 0);
+        header.max_inputs = cell.inputs().size();
+        header.max_outputs = cell.outputs().size();
+        header.max_fanouts = cell.get_oport(0).size() + cell.get_oport(0).capacity_left();
+
+        std::vector<std::uint64_t> phases;
+        std::vector<std::uint64_t> net_offsets{ 0 };
+        std::vector<binary_pin> drivers;
+        std::vector<binary_pin> sinks;
+        phases.reserve(flat.num_atoms());
+
+        for (FlatNetlist::id_type id = 0; id < flat.num_atoms(); ++id) {
+            const Atom &atom = flat.get_atom(id);
+            if (flat.is_cell(id)) {
+                RUNTIME_ASSERT(atom.inputs().size() == header.max_inputs && atom.outputs().size() == header.max_outputs);
+            }
+            phases.push_back(atom.get_phase());
+
+            for (const OPort &oport : atom.outputs()) {
+                RUNTIME_ASSERT(oport.size() + oport.capacity_left() == header.max_fanouts);
+                if (oport.empty()) continue;
+
+                drivers.push_back(binary_pin{ id, static_cast<std::uint32_t>(impl::port_index(oport)) });
+                for (const IPort* iport : oport) {
+                    sinks.push_back(binary_pin{ flat.atom_id(iport->get_atom()),
+                                                static_cast<std::uint32_t>(impl::port_index(*iport)) });
+                }
+                net_offsets.push_back(sinks.size());
+            }
+        }
+
+        header.num_nets = drivers.size();
+        header.num_sinks = sinks.size();
+
+        std::ofstream hfile{ filepath, std::ios::binary };
+        RUNTIME_ASSERT(hfile.is_open());
+
+        hfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        impl::write_array(hfile, phases);
+        impl::write_array(hfile, net_offsets);
+        impl::write_array(hfile, drivers);
+        impl::write_array(hfile, sinks);
+        hfile.flush();
+        RUNTIME_ASSERT(hfile);
+    }
+
+    Netlist load_binary_netlist(const std::string &filepath) {
+        return binary_netlist_view{ filepath }.build();
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,81 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#pragma once
+
+#include <boost/range/iterator_range.hpp>
+#include <cstdint>
+
+#include "mapped_file.h"
+#include "netlist.h"
+
+namespace Utils {
+
+    // On-disk layout, host byte order, every section 8-byte aligned:
+    //   binary_netlist_header
+    //   std::uint64_t phases[num_atoms]
+    //   std::uint64_t net_offsets[num_nets + 1]   (into sinks)
+    //   binary_pin drivers[num_nets]
+    //   binary_pin sinks[num_sinks]
+    // Atoms are numbered LUTs, FFs, IPins, OPins as in FlatNetlist. Only driven OPorts are stored.
+    struct binary_netlist_header {
+        char magic[4];
+        std::uint32_t version;
+        std::uint32_t byte_order;
+        std::uint32_t reserved;
+        std::uint64_t num_ipins;
+        std::uint64_t num_opins;
+        std::uint64_t num_luts;
+        std::uint64_t num_ffs;
+        std::uint64_t max_inputs;
+        std::uint64_t max_outputs;
+        std::uint64_t max_fanouts;
+        std::uint64_t num_nets;
+        std::uint64_t num_sinks;
+    };
+
+    struct binary_pin {
+        std::uint32_t atom;
+        std::uint32_t port;
+    };
+
+    // Zero-copy view of a binary netlist file. The arrays point straight into the mapping; the
+    // constructor checks every section against the file size and the net offsets against the
+    // sinks, so the accessors trust them.
+    class binary_netlist_view {
+
+    public:
+
+        static constexpr std::uint32_t version = 1;
+
+        explicit binary_netlist_view(const std::string &filepath);
+
+        inline const binary_netlist_header &header() const { return *m_header; }
+        inline std::size_t num_atoms() const {
+            return m_header->num_luts + m_header->num_ffs + m_header->num_ipins + m_header->num_opins;
+        }
+        inline std::size_t num_nets() const { return m_header->num_nets; }
+
+        inline std::uint64_t phase(std::size_t atom) const { return m_phases[atom]; }
+        inline const binary_pin &net_driver(std::size_t net) const { return m_drivers[net]; }
+        inline auto net_sinks(std::size_t net) const {
+            return boost::make_iterator_range(m_sinks + m_net_offsets[net], m_sinks + m_net_offsets[net + 1]);
+        }
+
+        Netlist build() const;
+
+    private:
+
+        mapped_file m_file;
+        const binary_netlist_header* m_header;
+        const std::uint64_t* m_phases;
+        const std::uint64_t* m_net_offsets;
+        const binary_pin* m_drivers;
+        const binary_pin* m_sinks;
+
+    };
+
+    void save_binary_netlist(const Netlist &netlist, const std::string &filepath);
+    Netlist load_binary_netlist(const std::string &filepath);
+
+}
\ No newline at end of file
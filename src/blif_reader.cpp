@@ -0,0 +1,355 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#include <boost/utility/string_view.hpp>
+#include <limits>
+#include <stdexcept>
+
+#include "blif_reader.h"
+#include "mapped_file.h"
+
+namespace Utils {
+
+    namespace impl {
+
+        using token = boost::string_view;
+
+        struct token_hash {
+            std::size_t operator()(token tok) const {
+                std::uint64_t hash = 14695981039346656037ull;
+                for (char c : tok) {
+                    hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+                }
+                return static_cast<std::size_t>(hash);
+            }
+        };
+
+        // Splits the mapped file into logical lines: comments are dropped, '\' joins continued
+        // lines and tokens point straight into the mapping.
+        class blif_tokenizer {
+
+        public:
+
+            blif_tokenizer(const char* begin, const char* end)
+                :m_pos{ begin },
+                m_end{ end },
+                m_line{ 1 },
+                m_first_line{ 1 }
+            {}
+
+            inline std::size_t line() const { return m_first_line; }
+
+            bool next(std::vector<token> &tokens) {
+                tokens.clear();
+                while (m_pos != m_end) {
+                    char c = *m_pos;
+                    if (c == '\n') {
+                        ++m_pos;
+                        ++m_line;
+                        if (!tokens.empty()) return true;
+                    }
+                    else if (c == ' ' || c == '\t' || c == '\r') {
+                        ++m_pos;
+                    }
+                    else if (c == '#') {
+                        while (m_pos != m_end && *m_pos != '\n') ++m_pos;
+                    }
+                    else if (c == '\\' && continues_line(m_pos + 1)) {
+                        skip_continuation(m_pos + 1);
+                    }
+                    else {
+                        const char* begin = m_pos;
+                        while (m_pos != m_end && !is_separator(*m_pos)) ++m_pos;
+
+                        const char* end = m_pos;
+                        if (end - begin > 1 && *(end - 1) == '\\' && continues_line(end)) {
+                            --end;
+                            skip_continuation(m_pos);
+                        }
+                        if (tokens.empty()) m_first_line = m_line;
+                        tokens.emplace_back(begin, end - begin);
+                    }
+                }
+                return !tokens.empty();
+            }
+
+        private:
+
+            static bool is_separator(char c) {
+                return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '#';
+            }
+
+            bool continues_line(const char* pos) const {
+                while (pos != m_end && (*pos == ' ' || *pos == '\t' || *pos == '\r')) ++pos;
+                return pos == m_end || *pos == '\n';
+            }
+
+            void skip_continuation(const char* pos) {
+                while (pos != m_end && *pos != '\n') ++pos;
+                if (pos != m_end) {
+                    ++pos;
+                    ++m_line;
+                }
+                m_pos = pos;
+            }
+
+            const char* m_pos;
+            const char* m_end;
+            std::size_t m_line;
+            std::size_t m_first_line;
+
+        };
+
+        // Open-addressing map from signal name to dense id. Names stay in the mapping; a slot keeps
+        // the full hash so most probes never touch the string.
+        class signal_table {
+
+        public:
+
+            static constexpr std::uint32_t empty_slot = std::numeric_limits<std::uint32_t>::max();
+
+            explicit signal_table(std::size_t expected)
+                :m_slots(next_pow2(expected * 2), slot{ 0, empty_slot })
+            {}
+
+            inline std::size_t size() const { return m_names.size(); }
+            inline token name(std::uint32_t id) const { return m_names[id]; }
+
+            std::pair<std::uint32_t, bool> insert(token name) {
+                if ((m_names.size() + 1) * 2 > m_slots.size()) grow();
+
+                std::uint32_t hash = static_cast<std::uint32_t>(token_hash{}(name));
+                std::size_t mask = m_slots.size() - 1;
+                for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+                    slot &s = m_slots[i];
+                    if (s.id == empty_slot) {
+                        s = slot{ hash, static_cast<std::uint32_t>(m_names.size()) };
+                        m_names.push_back(name);
+                        return { s.id, true };
+                    }
+                    if (s.hash == hash && m_names[s.id] == name) return { s.id, false };
+                }
+            }
+
+        private:
+
+            struct slot {
+                std::uint32_t hash;
+                std::uint32_t id;
+            };
+
+            static std::size_t next_pow2(std::size_t n) {
+                std::size_t size = 16;
+                while (size < n) size *= 2;
+                return size;
+            }
+
+            void grow() {
+                std::vector<slot> slots(m_slots.size() * 2, slot{ 0, empty_slot });
+                std::size_t mask = slots.size() - 1;
+                for (const slot &s : m_slots) {
+                    if (s.id == empty_slot) continue;
+                    std::size_t i = s.hash & mask;
+                    while (slots[i].id != empty_slot) i = (i + 1) & mask;
+                    slots[i] = s;
+                }
+                m_slots.swap(slots);
+            }
+
+            std::vector<slot> m_slots;
+            std::vector<token> m_names;
+
+        };
+
+        constexpr std::uint32_t signal_table::empty_slot;
+
+        enum class driver_kind { none, ipin, lut, ff };
+
+        struct signal {
+            driver_kind kind;
+            std::uint32_t index;
+            std::uint32_t num_fanouts;
+            std::uint32_t line;
+        };
+
+        struct blif_cell {
+            std::uint32_t first_input;
+            std::uint32_t num_inputs;
+        };
+
+        class blif_builder {
+
+        public:
+
+            explicit blif_builder(const std::string &filepath)
+                :m_filepath{ filepath },
+                m_signal_ids{ 0 }
+            {}
+
+            Netlist read() {
+                mapped_file file{ m_filepath };
+                blif_tokenizer tokenizer{ file.data(), file.data() + file.size() };
+                m_signal_ids = signal_table{ file.size() / 32 };
+
+                std::vector<token> tokens;
+                bool in_model = false;
+                while (tokenizer.next(tokens)) {
+                    m_line = tokenizer.line();
+                    const token &cmd = tokens.front();
+                    if (cmd.front() != '.') {
+                        if (!m_in_names) fail("unexpected \"" + cmd.to_string() + "\"");
+                        continue;
+                    }
+
+                    m_in_names = false;
+                    if (cmd == ".model") {
+                        if (in_model) fail("nested .model");
+                        in_model = true;
+                    }
+                    else if (cmd == ".end" || cmd == ".exdc") {
+                        // The external don't-care network runs up to the model's .end
+                        break;
+                    }
+                    else if (cmd == ".inputs") {
+                        for (std::size_t i = 1; i < tokens.size(); ++i) {
+                            define(tokens[i], driver_kind::ipin, m_ipins.size());
+                            m_ipins.push_back(signal_id(tokens[i]));
+                        }
+                    }
+                    else if (cmd == ".outputs") {
+                        for (std::size_t i = 1; i < tokens.size(); ++i) {
+                            m_opins.push_back(use(tokens[i]));
+                        }
+                    }
+                    else if (cmd == ".names") {
+                        if (tokens.size() < 2) fail(".names without an output");
+                        add_cell(m_luts, tokens.begin() + 1, tokens.end() - 1);
+                        define(tokens.back(), driver_kind::lut, m_luts.size() - 1);
+                        m_in_names = true;
+                    }
+                    else if (cmd == ".latch") {
+                        if (tokens.size() < 3) fail(".latch needs an input and an output");
+                        add_cell(m_ffs, tokens.begin() + 1, tokens.begin() + 2);
+                        define(tokens[2], driver_kind::ff, m_ffs.size() - 1);
+                    }
+                    else if (cmd == ".subckt" || cmd == ".gate" || cmd == ".mlatch") {
+                        fail(cmd.to_string() + " is not supported, flatten the design first");
+                    }
+                    else {
+                        fail("unknown command " + cmd.to_string());
+                    }
+                }
+
+                return build();
+            }
+
+        private:
+
+            [[noreturn]] void fail(const std::string &message) const {
+                throw std::runtime_error{ m_filepath + ":" + std::to_string(m_line) + ": " + message };
+            }
+
+            std::uint32_t signal_id(token name) {
+                auto result = m_signal_ids.insert(name);
+                if (result.second) m_signals.push_back(signal{ driver_kind::none, 0, 0, static_cast<std::uint32_t>(m_line) });
+                return result.first;
+            }
+
+            std::uint32_t use(token name) {
+                std::uint32_t id = signal_id(name);
+                ++m_signals[id].num_fanouts;
+                return id;
+            }
+
+            void define(token name, driver_kind kind, std::size_t index) {
+                signal &sig = m_signals[signal_id(name)];
+                if (sig.kind != driver_kind::none) fail("\"" + name.to_string() + "\" has more than one driver");
+                sig.kind = kind;
+                sig.index = static_cast<std::uint32_t>(index);
+            }
+
+            template <typename Iter>
+            void add_cell(std::vector<blif_cell> &cells, Iter begin, Iter end) {
+                blif_cell cell{ static_cast<std::uint32_t>(m_cell_inputs.size()), static_cast<std::uint32_t>(end - begin) };
+                for (Iter iter = begin; iter != end; ++iter) {
+                    m_cell_inputs.push_back(use(*iter));
+                }
+                m_max_inputs = std::max<std::size_t>(m_max_inputs, cell.num_inputs);
+                cells.push_back(cell);
+            }
+
+            Netlist build() {
+                if (m_ipins.empty() || m_opins.empty() || m_luts.empty() || m_ffs.empty()) {
+                    throw std::runtime_error{ m_filepath + ": the placers need at least one input, output, .names and .latch" };
+                }
+
+                std::size_t max_fanouts = 1;
+                for (const signal &sig : m_signals) {
+                    max_fanouts = std::max<std::size_t>(max_fanouts, sig.num_fanouts);
+                }
+
+                Netlist netlist{ m_ipins.size(), m_opins.size(), m_luts.size(), m_ffs.size(),
+                                 std::max<std::size_t>(m_max_inputs, 1), 1, max_fanouts };
+
+                auto driver = [&](std::uint32_t id) -> OPort& {
+                    const signal &sig = m_signals[id];
+                    switch (sig.kind) {
+                    case driver_kind::ipin:
+                        return get<IPin>(netlist, sig.index).get_oport();
+                    case driver_kind::lut:
+                        return get<Netlist::LUT>(netlist, sig.index).get_oport(0);
+                    case driver_kind::ff:
+                        return get<Netlist::FF>(netlist, sig.index).get_oport(0);
+                    case driver_kind::none:
+                        break;
+                    }
+                    throw std::runtime_error{ m_filepath + ":" + std::to_string(sig.line) + ": \"" +
+                                              m_signal_ids.name(id).to_string() + "\" is never driven" };
+                };
+
+                for (std::uint32_t id = 0; id < m_signals.size(); ++id) {
+                    if (m_signals[id].kind != driver_kind::none) driver(id).reserve(m_signals[id].num_fanouts);
+                }
+
+                auto connect_cells = [&](const std::vector<blif_cell> &cells, auto &&cell_at) {
+                    for (std::size_t i = 0; i < cells.size(); ++i) {
+                        Atom &atom = cell_at(i);
+                        atom.set_phase(0);
+                        for (std::uint32_t k = 0; k < cells[i].num_inputs; ++k) {
+                            connect(driver(m_cell_inputs[cells[i].first_input + k]), atom.get_iport(k));
+                        }
+                    }
+                };
+
+                connect_cells(m_luts, [&](std::size_t i) -> Atom& { return get<Netlist::LUT>(netlist, i); });
+                connect_cells(m_ffs, [&](std::size_t i) -> Atom& { return get<Netlist::FF>(netlist, i); });
+                for (std::size_t i = 0; i < m_opins.size(); ++i) {
+                    connect(driver(m_opins[i]), get<OPin>(netlist, i));
+                }
+
+                return netlist;
+            }
+
+            const std::string &m_filepath;
+            std::size_t m_line = 0;
+            bool m_in_names = false;
+            std::size_t m_max_inputs = 0;
+
+            signal_table m_signal_ids;
+            std::vector<signal> m_signals;
+
+            std::vector<std::uint32_t> m_ipins;
+            std::vector<std::uint32_t> m_opins;
+            std::vector<blif_cell> m_luts;
+            std::vector<blif_cell> m_ffs;
+            std::vector<std::uint32_t> m_cell_inputs;
+
+        };
+
+    }
+
+    Netlist read_blif(const std::string &filepath) {
+        return impl::blif_builder{ filepath }.read();
+    }
+
+}
\ No newline at end of file
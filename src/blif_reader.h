@@ -0,0 +1,16 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#pragma once
+
+#include "netlist.h"
+
+namespace Utils {
+
+    // Reads the first model of a flat BLIF file. .inputs become IPins, .outputs OPins, .names
+    // LUTs and .latch FFs. Every LUT and FF gets as many inputs as the widest .names; unused
+    // inputs stay unconnected. An .exdc network is ignored and any other command is an error.
+    // The placers need at least one of each atom, so models without one are rejected too.
+    Netlist read_blif(const std::string &filepath);
+
+}
\ No newline at end of file
@@ -0,0 +1,204 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+#include "checkpoint.h"
+
+namespace Utils {
+
+    namespace impl {
+
+        constexpr char checkpoint_magic[4] = { 'P', 'L', 'C', 'K' };
+        constexpr std::uint32_t checkpoint_version = 2;
+        constexpr std::uint32_t checkpoint_byte_order = 0x01020304;
+
+        // The standard only defines the stream representation of an engine, so the words are
+        // parsed out of it rather than taken from the engine's internals.
+        std::vector<std::uint32_t> engine_words(const std::mt19937 &engine) {
+            std::stringstream ss;
+            ss << engine;
+            std::vector<std::uint32_t> words;
+            std::uint64_t word;
+            while (ss >> word) words.push_back(static_cast<std::uint32_t>(word));
+            return words;
+        }
+
+        std::mt19937 engine_from_words(const std::vector<std::uint32_t> &words) {
+            std::stringstream ss;
+            for (std::uint32_t word : words) ss << word << ' ';
+            std::mt19937 engine;
+            ss >> engine;
+            RUNTIME_ASSERT(!ss.fail());
+            return engine;
+        }
+
+        template <typename T>
+        void read_array(std::ifstream &is, std::vector<T> &values, std::size_t size) {
+            values.resize(size);
+            is.read(reinterpret_cast<char*>(values.data()), size * sizeof(T));
+        }
+
+    }
+
+    void save_checkpoint(const anneal_checkpoint &checkpoint, const std::string &filepath) {
+        std::vector<std::uint32_t> words = impl::engine_words(checkpoint.engine);
+
+        checkpoint_header header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, impl::checkpoint_magic, sizeof(header.magic));
+        header.version = impl::checkpoint_version;
+        header.byte_order = impl::checkpoint_byte_order;
+        header.kind = checkpoint.kind;
+        header.width = checkpoint.width;
+        header.height = checkpoint.height;
+        header.iteration = checkpoint.iteration;
+        header.move = checkpoint.move;
+        header.temperature = checkpoint.temperature;
+        header.num_stalled = checkpoint.num_stalled;
+        header.range_limit = checkpoint.range_limit;
+        header.bbox = checkpoint.bbox;
+        header.num_engine_words = words.size();
+        header.num_sites = checkpoint.sites.size();
+
+        std::string tmp_filepath = filepath + ".tmp";
+        {
+            std::ofstream hfile{ tmp_filepath, std::ios::binary };
+            RUNTIME_ASSERT(hfile.is_open());
+
+            hfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            hfile.write(reinterpret_cast<const char*>(words.data()), words.size() * sizeof(std::uint32_t));
+            hfile.write(reinterpret_cast<const char*>(checkpoint.sites.data()), checkpoint.sites.size() * sizeof(FlatNetlist::id_type));
+            hfile.flush();
+            RUNTIME_ASSERT(hfile);
+        }
+        RUNTIME_ASSERT(std::rename(tmp_filepath.c_str(), filepath.c_str()) == 0);
+    }
+
+    anneal_checkpoint load_checkpoint(const std::string &filepath) {
+        std::ifstream hfile{ filepath, std::ios::binary };
+        RUNTIME_ASSERT(hfile.is_open());
+
+        checkpoint_header header;
+        hfile.read(reinterpret_cast<char*>(&header), sizeof(header));
+        RUNTIME_ASSERT(hfile);
+        RUNTIME_ASSERT(std::memcmp(header.magic, impl::checkpoint_magic, sizeof(header.magic)) == 0);
+        RUNTIME_ASSERT(header.version == impl::checkpoint_version);
+        RUNTIME_ASSERT(header.byte_order == impl::checkpoint_byte_order);
+
+        // The loop state is checked as far as it can be without the schedule: annealing needs a
+        // usable temperature, stalls are counted per temperature and a range limit spans at most
+        // the whole chip.
+        RUNTIME_ASSERT(header.kind == checkpoint_kind::random_placement || header.kind == checkpoint_kind::simulated_annealing ||
+                       header.kind == checkpoint_kind::adaptive_annealing);
+        RUNTIME_ASSERT(header.iteration >= 0 && header.num_stalled <= static_cast<std::uint64_t>(header.iteration));
+        RUNTIME_ASSERT(header.move >= 0 && (header.move == 0 || header.kind == checkpoint_kind::simulated_annealing));
+        if (header.kind != checkpoint_kind::random_placement) {
+            RUNTIME_ASSERT(std::isfinite(header.temperature) && header.temperature > 0.0);
+        }
+        if (header.kind == checkpoint_kind::adaptive_annealing) {
+            RUNTIME_ASSERT(header.range_limit >= 1 &&
+                           static_cast<std::uint64_t>(header.range_limit) <= std::max(header.width, header.height));
+        }
+
+        // The counts are checked before anything is allocated from them. The engine's stream
+        // representation is its state, followed in libstdc++ by its position in that state.
+        RUNTIME_ASSERT(header.num_engine_words == std::mt19937::state_size || header.num_engine_words == std::mt19937::state_size + 1);
+        RUNTIME_ASSERT(header.height == 0 || header.width <= std::numeric_limits<std::uint64_t>::max() / header.height);
+        RUNTIME_ASSERT(header.num_sites == header.width * header.height);
+
+        std::streamoff arrays_begin = hfile.tellg();
+        hfile.seekg(0, std::ios::end);
+        std::uint64_t arrays_size = static_cast<std::uint64_t>(hfile.tellg() - arrays_begin);
+        hfile.seekg(arrays_begin);
+        RUNTIME_ASSERT(header.num_sites <= arrays_size / sizeof(FlatNetlist::id_type));
+
+        anneal_checkpoint checkpoint;
+        checkpoint.kind = header.kind;
+        checkpoint.width = header.width;
+        checkpoint.height = header.height;
+        checkpoint.iteration = header.iteration;
+        checkpoint.move = header.move;
+        checkpoint.temperature = header.temperature;
+        checkpoint.num_stalled = header.num_stalled;
+        checkpoint.range_limit = header.range_limit;
+        checkpoint.bbox = header.bbox;
+
+        std::vector<std::uint32_t> words;
+        impl::read_array(hfile, words, header.num_engine_words);
+        impl::read_array(hfile, checkpoint.sites, header.num_sites);
+        RUNTIME_ASSERT(hfile && hfile.peek() == std::ifstream::traits_type::eof());
+        checkpoint.engine = impl::engine_from_words(words);
+
+        return checkpoint;
+    }
+
+    checkpoint_writer::checkpoint_writer(const checkpoint_options &options)
+        :m_options{ options },
+        m_enabled{ !options.filepath.empty() },
+        m_last_submit{ std::chrono::steady_clock::now() }
+    {
+        if (m_enabled) m_thread = std::thread{ [this]() { run(); } };
+    }
+
+    checkpoint_writer::~checkpoint_writer() {
+        try {
+            finish();
+        }
+        catch (...) {}
+    }
+
+    void checkpoint_writer::submit(std::unique_ptr<anneal_checkpoint> checkpoint) {
+        RUNTIME_ASSERT(m_enabled);
+        m_last_submit = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock{ m_mutex };
+            m_pending = std::move(checkpoint);
+        }
+        m_cv.notify_one();
+    }
+
+    void checkpoint_writer::finish() {
+        if (m_thread.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock{ m_mutex };
+                m_stopping = true;
+            }
+            m_cv.notify_one();
+            m_thread.join();
+        }
+
+        if (m_error) {
+            std::exception_ptr error = m_error;
+            m_error = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+    void checkpoint_writer::run() {
+        std::unique_lock<std::mutex> lock{ m_mutex };
+        while (true) {
+            m_cv.wait(lock, [this]() { return m_pending || m_stopping; });
+            if (!m_pending) return;
+
+            std::unique_ptr<anneal_checkpoint> checkpoint = std::move(m_pending);
+            lock.unlock();
+            try {
+                save_checkpoint(*checkpoint, m_options.filepath);
+            }
+            catch (...) {
+                lock.lock();
+                if (!m_error) m_error = std::current_exception();
+                continue;
+            }
+            lock.lock();
+        }
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,116 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "flat_netlist.h"
+
+namespace Utils {
+
+    enum class checkpoint_kind : std::uint32_t {
+        random_placement = 1,
+        simulated_annealing = 2,
+        adaptive_annealing = 3
+    };
+
+    // On-disk layout, host byte order:
+    //   checkpoint_header
+    //   std::uint32_t engine_words[num_engine_words]   (the std::mt19937 stream representation)
+    //   std::uint32_t sites[num_sites]                 (atom id of every site, or invalid_id)
+    struct checkpoint_header {
+        char magic[4];
+        std::uint32_t version;
+        std::uint32_t byte_order;
+        checkpoint_kind kind;
+        std::uint64_t width;
+        std::uint64_t height;
+        std::int64_t iteration;
+        std::int64_t move;
+        double temperature;
+        std::uint64_t num_stalled;
+        std::int64_t range_limit;
+        std::int64_t bbox;
+        std::uint64_t num_engine_words;
+        std::uint64_t num_sites;
+    };
+
+    // Everything a placer needs to continue bit-exactly: the board and the loop state at the
+    // start of the iteration it resumes from. iteration counts moves for random placement and
+    // temperatures for annealing; move is the next move within that temperature for the fixed
+    // schedule and zero otherwise.
+    struct anneal_checkpoint {
+        checkpoint_kind kind;
+        std::size_t width;
+        std::size_t height;
+        std::int64_t iteration = 0;
+        std::int64_t move = 0;
+        double temperature = 0.0;
+        std::size_t num_stalled = 0;
+        std::int64_t range_limit = 0;
+        std::int64_t bbox = 0;
+        std::mt19937 engine;
+        std::vector<FlatNetlist::id_type> sites;
+    };
+
+    // Writes to filepath.tmp and renames it over filepath, so a run killed mid-write leaves the
+    // previous checkpoint intact.
+    void save_checkpoint(const anneal_checkpoint &checkpoint, const std::string &filepath);
+    anneal_checkpoint load_checkpoint(const std::string &filepath);
+
+    // An empty filepath disables checkpointing.
+    struct checkpoint_options {
+        std::string filepath;
+        std::chrono::milliseconds interval{ 60000 };
+    };
+
+    // Saves checkpoints on a thread of its own. The placer only copies its state into submit();
+    // a checkpoint submitted while the previous one is still being written replaces it.
+    class checkpoint_writer {
+
+    public:
+
+        explicit checkpoint_writer(const checkpoint_options &options);
+        ~checkpoint_writer();
+
+        checkpoint_writer(const checkpoint_writer&) = delete;
+        checkpoint_writer &operator=(const checkpoint_writer&) = delete;
+
+        inline bool enabled() const { return m_enabled; }
+
+        inline bool due() const {
+            return m_enabled && std::chrono::steady_clock::now() - m_last_submit >= m_options.interval;
+        }
+
+        void submit(std::unique_ptr<anneal_checkpoint> checkpoint);
+
+        // Waits for the pending checkpoint and rethrows the first error of the writer thread.
+        void finish();
+
+    private:
+
+        void run();
+
+        checkpoint_options m_options;
+        bool m_enabled;
+        std::chrono::steady_clock::time_point m_last_submit;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::unique_ptr<anneal_checkpoint> m_pending;
+        bool m_stopping = false;
+        std::exception_ptr m_error;
+        std::thread m_thread;
+
+    };
+
+}
\ No newline at end of file
@@ -1,121 +1,166 @@
 // (C) Copyright Shou Hao Ho   2018
 // Distributed under the MIT Software License (See accompanying LICENSE file)
 
-#include <numeric>
 #include "chip.h"
+#include "perf_counters.h"
+#include "stats.h"
+#include "trace.h"
 
-std::size_t Chip::swap(const Atom &lhs_atom, std::size_t idx) {
-    auto lhs_iter = m_board.right.find(&lhs_atom);
-    RUNTIME_ASSERT(lhs_iter != m_board.right.end());
+constexpr std::size_t Chip::invalid_site;
 
-    std::size_t lhs_ori_idx = lhs_iter->second;
-    std::size_t rhs_ori_idx = lhs_atom.get_type() == Atom::type::LUT ? lut_to_idx(idx) : ff_to_idx(idx);
-    RUNTIME_ASSERT(rhs_ori_idx < m_width * m_height);
-    if (lhs_ori_idx == rhs_ori_idx) return idx;
+std::int64_t Chip::evaluate_swap(const Atom &lhs_atom, std::size_t idx) const {
+    pending_swap move;
+    return evaluate_swap(lhs_atom, idx, move);
+}
 
-    m_bbox -= bbox_for_atom(lhs_atom);
+std::int64_t Chip::evaluate_swap(const Atom &lhs_atom, std::size_t idx, pending_swap &move) const {
+    PLACER_STATS_ADD(swap_evaluations, 1);
+    prepare_swap(lhs_atom, idx, move);
+    move.delta = move.lhs_site == move.rhs_site ? 0 : swap_delta(move);
+    return move.delta;
+}
 
-    auto rhs_iter = m_board.left.find(rhs_ori_idx);
-    if (rhs_iter != m_board.left.end()) {
-        const Atom &rhs_atom = *rhs_iter->second;
-        m_bbox -= bbox_for_atom(rhs_atom);
+std::size_t Chip::commit(const pending_swap &move) {
+    // A LUT site is even and an FF site the odd one after it, so both halve to the index
+    if (move.lhs_site == move.rhs_site) return move.lhs_site / 2;
 
-        m_board.right.erase(lhs_iter);
-        m_board.left.erase(rhs_iter);
-        m_board.insert({ lhs_ori_idx,  &rhs_atom });
-        m_board.insert({ rhs_ori_idx,  &lhs_atom });
+    for (const affected_net &entry : move.nets) m_net_bboxes[entry.net] = entry.updated;
+    m_bbox += move.delta;
 
-        m_bbox += bbox_for_atom(rhs_atom);
-        m_bbox += bbox_for_atom(lhs_atom);
+    if (move.rhs_id != FlatNetlist::invalid_id) {
+        place(move.rhs_id, move.lhs_site);
     }
     else {
-        m_board.right.erase(lhs_iter);
-        m_board.insert({ rhs_ori_idx,  &lhs_atom });
-        m_bbox += bbox_for_atom(lhs_atom);
+        m_site_to_atom[move.lhs_site] = FlatNetlist::invalid_id;
+    }
+    place(move.lhs_id, move.rhs_site);
+
+    return move.lhs_site / 2;
+}
+
+std::size_t Chip::swap(const Atom &lhs_atom, std::size_t idx) {
+    pending_swap move;
+    evaluate_swap(lhs_atom, idx, move);
+    return commit(move);
+}
+
+void Chip::prepare_swap(const Atom &lhs_atom, std::size_t idx, pending_swap &move) const {
+    move.lhs_id = m_flat->atom_id(lhs_atom);
+    RUNTIME_ASSERT(m_flat->is_cell(move.lhs_id));
+
+    move.lhs_site = m_atom_to_site[move.lhs_id];
+    move.rhs_site = lhs_atom.get_type() == Atom::type::LUT ? lut_to_idx(idx) : ff_to_idx(idx);
+    RUNTIME_ASSERT(move.rhs_site < m_width * m_height);
+    move.rhs_id = m_site_to_atom[move.rhs_site];
+    move.nets.clear();
+    if (move.lhs_site == move.rhs_site) return;
+
+    collect_nets(move.lhs_id, 0, move.nets);
+    if (move.rhs_id != FlatNetlist::invalid_id) collect_nets(move.rhs_id, 1, move.nets);
+}
+
+std::int64_t Chip::swap_delta(pending_swap &move) const {
+    coord lhs_from = idx_to_coord(move.lhs_site);
+    coord lhs_to = idx_to_coord(move.rhs_site);
+
+    auto coord_of = [&](FlatNetlist::id_type id) {
+        if (id == move.lhs_id) return lhs_to;
+        if (id == move.rhs_id) return lhs_from;
+        return atom_coord(id);
+    };
+
+    std::int64_t delta = 0;
+    for (affected_net &entry : move.nets) {
+        const net_bbox &bb = m_net_bboxes[entry.net];
+        entry.updated = bb;
+        if (!move_pins(entry.updated, lhs_from, lhs_to, entry.num_pins[0]) ||
+            !move_pins(entry.updated, lhs_to, lhs_from, entry.num_pins[1]))
+        {
+            PLACER_STATS_ADD(net_bbox_rescans, 1);
+            entry.updated = compute_net_bbox(entry.net, coord_of);
+        }
+        delta += entry.updated.cost() - bb.cost();
     }
 
-    return lhs_atom.get_type() == Atom::type::LUT ? lhs_ori_idx / 2 : (lhs_ori_idx - 1) / 2;
+    return delta;
+}
+
+void Chip::init_pin_coords() {
+    m_pin_coords.reserve(m_netlist.num_ipins() + m_netlist.num_opins());
+    for (std::size_t i = 0; i < m_netlist.num_ipins(); ++i) {
+        m_pin_coords.push_back(coord{ -1, static_cast<std::int64_t>(i * (m_height / m_netlist.num_ipins())) });
+    }
+    for (std::size_t i = 0; i < m_netlist.num_opins(); ++i) {
+        m_pin_coords.push_back(coord{ static_cast<std::int64_t>(m_width), static_cast<std::int64_t>(i * (m_height / m_netlist.num_opins())) });
+    }
 }
 
 void Chip::initial_random_placement() {
     std::size_t i = 0;
     for (const auto &lut : m_netlist.luts()) {
-        m_board.insert({ lut_to_idx(i), &lut });
+        place(m_flat->atom_id(lut), lut_to_idx(i));
         ++i;
     }
     i = 0;
     for (const auto &ff : m_netlist.ffs()) {
-        m_board.insert({ ff_to_idx(i), &ff });
+        place(m_flat->atom_id(ff), ff_to_idx(i));
         ++i;
     }
-    RUNTIME_ASSERT(m_board.size() == m_netlist.num_luts() + m_netlist.num_ffs());
 }
 
-std::int64_t Chip::initial_bbox() {
-    std::int64_t total = std::accumulate(m_netlist.begin_ipins(), m_netlist.end_ipins(), std::int64_t(0),
-        [&](std::int64_t prev, const IPin &ipin) { return prev + bbox_for_net(ipin.get_oport()); });
-
-    auto acc_oports = [&](const auto &range) {
-        return std::accumulate(range.begin(), range.end(), 0,
-            [&](std::int64_t prev, const OPort &oport) { return prev + bbox_for_net(oport); });
-    };
-
-    total += std::accumulate(m_netlist.begin_luts(), m_netlist.end_luts(), 0,
-        [&](std::int64_t prev, const Atom &atom) { return prev + acc_oports(atom.outputs()); });
-
-    total += std::accumulate(m_netlist.begin_ffs(), m_netlist.end_ffs(), 0,
-        [&](std::int64_t prev, const Atom &atom) { return prev + acc_oports(atom.outputs()); });
+void Chip::restore_sites(const std::vector<FlatNetlist::id_type> &sites) {
+    RUNTIME_ASSERT(sites.size() == m_site_to_atom.size());
+    std::fill(m_site_to_atom.begin(), m_site_to_atom.end(), FlatNetlist::invalid_id);
+    std::fill(m_atom_to_site.begin(), m_atom_to_site.end(), invalid_site);
+
+    for (std::size_t idx = 0; idx < sites.size(); ++idx) {
+        FlatNetlist::id_type id = sites[idx];
+        if (id == FlatNetlist::invalid_id) continue;
+        RUNTIME_ASSERT(m_flat->is_cell(id) && m_atom_to_site[id] == invalid_site);
+        RUNTIME_ASSERT((idx % 2 == 0) == (id < m_netlist.num_luts()));
+        place(id, idx);
+    }
 
-    return total;
+    RUNTIME_ASSERT(std::none_of(m_atom_to_site.begin(), m_atom_to_site.end(),
+        [](std::size_t site) { return site == invalid_site; }));
+    m_bbox = initial_bbox();
 }
 
-std::int64_t Chip::bbox_for_net(const Net &net) const {
-    coord src_coord;
-    if (auto ipin_opt = get_coord(static_cast<const IPin&>(net.get_atom()))) {
-        src_coord = *ipin_opt;
-    }
-    else {
-        src_coord = get_coord(net.get_atom());
-    }
+std::int64_t Chip::initial_bbox() {
+    PLACER_TRACE_SPAN("initial_bbox");
+    PLACER_PERF_STAGE(initial_bbox);
+    auto coord_of = [&](FlatNetlist::id_type id) { return atom_coord(id); };
 
-    std::int64_t min_x, max_x, min_y, max_y;
-    min_x = max_x = src_coord.x;
-    min_y = max_y = src_coord.y;
+    m_net_bboxes.clear();
+    m_net_bboxes.reserve(m_flat->num_nets());
 
-    for (const IPort* iport : net) {
-        coord dest_coord;
-        if (auto opin_opt = get_coord(static_cast<const OPin&>(iport->get_atom()))) {
-            dest_coord = *opin_opt;
-        }
-        else {
-            dest_coord = get_coord(iport->get_atom());
-        }
-        min_x = std::min(min_x, static_cast<std::int64_t>(dest_coord.x));
-        max_x = std::max(max_x, static_cast<std::int64_t>(dest_coord.x));
-        min_y = std::min(min_y, static_cast<std::int64_t>(dest_coord.y));
-        max_y = std::max(max_y, static_cast<std::int64_t>(dest_coord.y));
+    std::int64_t total = 0;
+    for (FlatNetlist::id_type net = 0; net < m_flat->num_nets(); ++net) {
+        m_net_bboxes.push_back(compute_net_bbox(net, coord_of));
+        total += m_net_bboxes.back().cost();
     }
-
-    std::int64_t x_diff = max_x - min_x;
-    std::int64_t y_diff = max_y - min_y;
-    return std::abs(x_diff) + std::abs(y_diff);
+    return total;
 }
 
-std::int64_t Chip::bbox_for_atom(const Atom &atom) const {
-    auto acc_iports = [&](std::int64_t prev, const IPort &iport) {
-        return prev + (iport.has_fanin() ? bbox_for_net(*iport.fanin()) : 0);
-    };
-    std::int64_t total = std::accumulate(atom.begin_inputs(), atom.end_inputs(), 0, acc_iports);
-
-    auto acc_oports = [&](std::int64_t prev, const OPort &oport) {
-        return prev + bbox_for_net(oport);
+void Chip::collect_nets(FlatNetlist::id_type atom, std::size_t side, affected_nets &nets) const {
+    auto add = [&](FlatNetlist::id_type net) {
+        auto iter = std::find_if(nets.begin(), nets.end(),
+            [&](const affected_net &entry) { return entry.net == net; });
+        if (iter == nets.end()) {
+            nets.push_back(affected_net{ net, { 0, 0 } });
+            iter = nets.end() - 1;
+        }
+        ++iter->num_pins[side];
     };
-    total += std::accumulate(atom.begin_outputs(), atom.end_outputs(), 0, acc_oports);
 
-    return total;
+    for (FlatNetlist::id_type net : m_flat->driven_nets(atom)) add(net);
+    for (FlatNetlist::id_type net : m_flat->fanin_nets(atom)) add(net);
 }
 
 void Chip::legalize_plan(const Plan &plan) {
+    PLACER_STATS_TIMER(legalization);
+    PLACER_TRACE_SPAN("legalize_plan");
+    PLACER_PERF_STAGE(legalization);
     for (const auto &entry : plan.board()) {
         coord new_coord{ static_cast<std::int64_t>(entry.second.x),
                          static_cast<std::int64_t>(entry.second.y) };
@@ -134,22 +179,27 @@ void Chip::legalize_plan(const Plan &plan) {
 
         std::size_t max_idx = m_width * m_height;
 
+        auto occupied = [&](std::int64_t i) {
+            return static_cast<std::size_t>(i) < max_idx && m_site_to_atom[i] != FlatNetlist::invalid_id;
+        };
+
         std::int64_t curr_idx = static_cast<std::int64_t>(idx);
-        auto iter = m_board.left.find(static_cast<std::size_t>(curr_idx));
+        bool taken = occupied(curr_idx);
 
-        while (iter != m_board.left.end() && curr_idx + 2 < static_cast<std::int64_t>(max_idx)) {
+        while (taken && curr_idx + 2 < static_cast<std::int64_t>(max_idx)) {
             curr_idx += 2;
-            iter = m_board.left.find(static_cast<std::size_t>(curr_idx));
+            taken = occupied(curr_idx);
         }
 
-        if (iter != m_board.left.end()) curr_idx = static_cast<std::int64_t>(idx);
-        while (iter != m_board.left.end() && curr_idx - 2 > 0) {
+        if (taken) curr_idx = static_cast<std::int64_t>(idx);
+        while (taken && curr_idx - 2 > 0) {
             curr_idx -= 2;
-            iter = m_board.left.find(static_cast<std::size_t>(curr_idx));
+            taken = occupied(curr_idx);
         }
 
         idx = static_cast<std::size_t>(curr_idx);
         RUNTIME_ASSERT(idx < max_idx);
-        m_board.insert({ idx, entry.first });
+        RUNTIME_ASSERT(!taken);
+        place(m_flat->atom_id(*entry.first), idx);
     }
 }
\ No newline at end of file
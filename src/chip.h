@@ -3,15 +3,51 @@
 
 #pragma once
 
+#include <boost/container/small_vector.hpp>
 #include <boost/range/adaptors.hpp>
+#include <boost/range/irange.hpp>
 #include "plan.h"
 
 using Net = OPort;
 
 class Chip {
 
+    // Bounding box of a net together with the number of pins sitting on each of its edges,
+    // so that moving a pin only needs a rescan when it was the last one on an edge.
+    struct net_bbox {
+        inline std::int64_t cost() const { return (max_x - min_x) + (max_y - min_y); }
+
+        std::int64_t min_x;
+        std::int64_t max_x;
+        std::int64_t min_y;
+        std::int64_t max_y;
+        std::uint32_t num_min_x;
+        std::uint32_t num_max_x;
+        std::uint32_t num_min_y;
+        std::uint32_t num_max_y;
+    };
+
+    struct affected_net {
+        FlatNetlist::id_type net;
+        std::uint32_t num_pins[2];
+        net_bbox updated;
+    };
+
+    using affected_nets = boost::container::small_vector<affected_net, 16>;
+
 public:
 
+    // A swap evaluated against the current placement, holding the bounding boxes its nets would
+    // end up with. It can be committed as long as none of its sites or nets changed since.
+    struct pending_swap {
+        FlatNetlist::id_type lhs_id;
+        FlatNetlist::id_type rhs_id;
+        std::size_t lhs_site;
+        std::size_t rhs_site;
+        std::int64_t delta;
+        affected_nets nets;
+    };
+
     struct coord {
         std::int64_t x;
         std::int64_t y;
@@ -20,11 +56,15 @@ public:
     Chip(std::size_t width, std::size_t height, const Netlist &netlist)
         :m_width{ width },
         m_height{ height },
-        m_netlist{ netlist }
+        m_netlist{ netlist },
+        m_flat{ std::make_shared<FlatNetlist>(netlist) },
+        m_site_to_atom(width * height, FlatNetlist::invalid_id),
+        m_atom_to_site(m_flat->num_cells(), invalid_site)
     {
         RUNTIME_ASSERT(width * height >= 2 * std::max(netlist.num_ffs(), netlist.num_luts()));
         RUNTIME_ASSERT(height >= netlist.num_ipins());
         RUNTIME_ASSERT(height >= netlist.num_opins());
+        init_pin_coords();
         initial_random_placement();
         m_bbox = initial_bbox();
     }
@@ -32,8 +72,12 @@ public:
     Chip(const Plan &plan)
         :m_width{ plan.get_width() },
         m_height{ plan.get_height() },
-        m_netlist{ plan.get_netlist() }
+        m_netlist{ plan.get_netlist() },
+        m_flat{ plan.share_flat_netlist() },
+        m_site_to_atom(m_width * m_height, FlatNetlist::invalid_id),
+        m_atom_to_site(m_flat->num_cells(), invalid_site)
     {
+        init_pin_coords();
         legalize_plan(plan);
         m_bbox = initial_bbox();
     }
@@ -43,7 +87,11 @@ public:
         m_width{ other.m_width },
         m_height{ other.m_height },
         m_netlist{ other.m_netlist },
-        m_board{ std::move(other.m_board) }
+        m_flat{ std::move(other.m_flat) },
+        m_pin_coords{ std::move(other.m_pin_coords) },
+        m_site_to_atom{ std::move(other.m_site_to_atom) },
+        m_atom_to_site{ std::move(other.m_atom_to_site) },
+        m_net_bboxes{ std::move(other.m_net_bboxes) }
     {}
 
     Chip operator=(const Chip&) = delete;
@@ -54,6 +102,7 @@ public:
 
     inline std::int64_t get_bbox() const { return m_bbox; }
     inline const Netlist &get_netlist() const { return m_netlist; }
+    inline const FlatNetlist &get_flat_netlist() const { return *m_flat; }
 
     inline auto ipins() { return m_netlist.ipins(); }
     inline auto ipins() const { return m_netlist.ipins(); }
@@ -72,46 +121,119 @@ public:
     inline auto end_opins() const { return opins().end(); }
 
     inline auto coords() const {
-        return m_board.left
-            | boost::adaptors::transformed([&](const auto &entry) { return idx_to_coord(entry.first); });
+        return boost::irange(std::size_t(0), m_site_to_atom.size())
+            | boost::adaptors::filtered([&](std::size_t idx) { return m_site_to_atom[idx] != FlatNetlist::invalid_id; })
+            | boost::adaptors::transformed([&](std::size_t idx) { return idx_to_coord(idx); });
     }
 
     inline coord get_coord(const Atom &atom) const {
-        auto iter = m_board.right.find(&atom);
-        RUNTIME_ASSERT(iter != m_board.right.end());
-        return idx_to_coord(iter->second);
+        FlatNetlist::id_type id = m_flat->atom_id(atom);
+        RUNTIME_ASSERT(m_flat->is_cell(id) && m_atom_to_site[id] != invalid_site);
+        return idx_to_coord(m_atom_to_site[id]);
     }
 
     inline boost::optional<coord> get_coord(const IPin &ipin) const {
-        auto iter = std::find_if(ipins().begin(), ipins().end(),
-            [&](const IPin &i) { return &i == &ipin; });
-        if (iter == ipins().end()) return boost::none;
-        return coord{ -1, static_cast<std::int64_t>((iter - ipins().begin()) * (m_height / m_netlist.num_ipins())) };
+        if (ipin.get_type() != Atom::type::IPIN) return boost::none;
+        return m_pin_coords[m_flat->atom_id(ipin) - m_flat->ipin_begin()];
     }
 
     inline boost::optional<coord> get_coord(const OPin &opin) const {
-        auto iter = std::find_if(opins().begin(), opins().end(),
-            [&](const OPin &o) { return &o == &opin; });
-        if (iter == opins().end()) return boost::none;
-        return coord{ static_cast<std::int64_t>(m_width), static_cast<std::int64_t>((iter - opins().begin()) * (m_height / m_netlist.num_opins())) };
+        if (opin.get_type() != Atom::type::OPIN) return boost::none;
+        return m_pin_coords[m_flat->atom_id(opin) - m_flat->ipin_begin()];
     }
 
+    std::int64_t evaluate_swap(const Atom &lhs_atom, std::size_t idx) const;
+    std::int64_t evaluate_swap(const Atom &lhs_atom, std::size_t idx, pending_swap &move) const;
+
+    // Applies an evaluated swap without evaluating it again. Returns the index the atom came from.
+    std::size_t commit(const pending_swap &move);
+
     std::size_t swap(const Atom &lhs_atom, std::size_t idx);
 
+    // Rebuilds every net bounding box from the placement, the full scan that swaps avoid.
+    inline std::int64_t recompute_bbox() { return m_bbox = initial_bbox(); }
+
+    // Atom id of every site, or FlatNetlist::invalid_id for an empty one.
+    inline const std::vector<FlatNetlist::id_type> &sites() const { return m_site_to_atom; }
+
+    // Replaces the placement with one taken from sites() of a chip of the same netlist and size.
+    void restore_sites(const std::vector<FlatNetlist::id_type> &sites);
+
 private:
 
+    static constexpr std::size_t invalid_site = std::numeric_limits<std::size_t>::max();
+
     Chip(const Chip &other)
         :m_bbox{ other.m_bbox },
         m_width{ other.m_width },
         m_height{ other.m_height },
         m_netlist{ other.m_netlist },
-        m_board{ other.m_board }
+        m_flat{ other.m_flat },
+        m_pin_coords{ other.m_pin_coords },
+        m_site_to_atom{ other.m_site_to_atom },
+        m_atom_to_site{ other.m_atom_to_site },
+        m_net_bboxes{ other.m_net_bboxes }
     {}
 
+    void init_pin_coords();
     void initial_random_placement();
     std::int64_t initial_bbox();
-    std::int64_t bbox_for_net(const Net &net) const;
-    std::int64_t bbox_for_atom(const Atom &atom) const;
+    void collect_nets(FlatNetlist::id_type atom, std::size_t side, affected_nets &nets) const;
+    void prepare_swap(const Atom &lhs_atom, std::size_t idx, pending_swap &move) const;
+
+    std::int64_t swap_delta(pending_swap &move) const;
+
+    template <typename CoordFunc>
+    net_bbox compute_net_bbox(FlatNetlist::id_type net, CoordFunc &&coord_of) const {
+        auto pins = m_flat->net_pins(net);
+        coord src_coord = coord_of(pins.front());
+        net_bbox bb{ src_coord.x, src_coord.x, src_coord.y, src_coord.y, 1, 1, 1, 1 };
+
+        for (FlatNetlist::id_type sink : boost::make_iterator_range(pins.begin() + 1, pins.end())) {
+            coord dest_coord = coord_of(sink);
+            add_to_edges(dest_coord.x, bb.min_x, bb.num_min_x, bb.max_x, bb.num_max_x);
+            add_to_edges(dest_coord.y, bb.min_y, bb.num_min_y, bb.max_y, bb.num_max_y);
+        }
+
+        return bb;
+    }
+
+    static inline void add_to_edges(std::int64_t v, std::int64_t &min, std::uint32_t &num_min,
+        std::int64_t &max, std::uint32_t &num_max)
+    {
+        if (v < min) { min = v; num_min = 1; }
+        else if (v == min) ++num_min;
+        if (v > max) { max = v; num_max = 1; }
+        else if (v == max) ++num_max;
+    }
+
+    static inline bool move_on_axis(std::int64_t from, std::int64_t to, std::uint32_t num_pins,
+        std::int64_t &min, std::uint32_t &num_min, std::int64_t &max, std::uint32_t &num_max)
+    {
+        if (to < from) {
+            if (from == max) {
+                if (num_max <= num_pins) return false;
+                num_max -= num_pins;
+            }
+            if (to < min) { min = to; num_min = num_pins; }
+            else if (to == min) num_min += num_pins;
+        }
+        else if (to > from) {
+            if (from == min) {
+                if (num_min <= num_pins) return false;
+                num_min -= num_pins;
+            }
+            if (to > max) { max = to; num_max = num_pins; }
+            else if (to == max) num_max += num_pins;
+        }
+        return true;
+    }
+
+    static inline bool move_pins(net_bbox &bb, const coord &from, const coord &to, std::uint32_t num_pins) {
+        if (num_pins == 0) return true;
+        return move_on_axis(from.x, to.x, num_pins, bb.min_x, bb.num_min_x, bb.max_x, bb.num_max_x) &&
+               move_on_axis(from.y, to.y, num_pins, bb.min_y, bb.num_min_y, bb.max_y, bb.num_max_y);
+    }
 
     void legalize_plan(const Plan &plan);
 
@@ -123,6 +245,16 @@ private:
         return ff_idx * 2 + 1;
     }
 
+    inline coord atom_coord(FlatNetlist::id_type id) const {
+        if (m_flat->is_cell(id)) return idx_to_coord(m_atom_to_site[id]);
+        return m_pin_coords[id - m_flat->ipin_begin()];
+    }
+
+    inline void place(FlatNetlist::id_type id, std::size_t idx) {
+        m_site_to_atom[idx] = id;
+        m_atom_to_site[id] = idx;
+    }
+
     inline coord idx_to_coord(std::size_t idx) const {
         return { static_cast<std::int64_t>(idx / m_width), static_cast<std::int64_t>(idx % m_width) };
     }
@@ -135,6 +267,10 @@ private:
     std::size_t m_width;
     std::size_t m_height;
     const Netlist &m_netlist;
-    boost::bimap<std::size_t, const Atom*> m_board;
+    std::shared_ptr<const FlatNetlist> m_flat;
+    std::vector<coord> m_pin_coords;
+    std::vector<FlatNetlist::id_type> m_site_to_atom;
+    std::vector<std::size_t> m_atom_to_site;
+    std::vector<net_bbox> m_net_bboxes;
 
 };
\ No newline at end of file
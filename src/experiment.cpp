@@ -0,0 +1,425 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#include <boost/lexical_cast.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <tuple>
+
+#include "binary_netlist.h"
+#include "blif_reader.h"
+#include "experiment.h"
+#include "placement.h"
+#include "trace.h"
+
+namespace Utils {
+
+    namespace impl {
+
+        using boost::property_tree::ptree;
+
+        const std::map<std::string, std::set<std::string>> &engine_params() {
+            static const std::map<std::string, std::set<std::string>> params{
+                { "random", { "width", "height", "iterations" } },
+                { "sa", { "width", "height", "iterations", "temperatures", "hot", "cooling" } },
+                { "sa_adaptive", { "width", "height", "moves_per_atom", "initial_temperature_factor", "exit_temperature_factor",
+                                   "improvement_tolerance", "max_stalled_temperatures", "range_limited", "seed" } },
+                { "parallel_sa", { "width", "height", "iterations", "temperatures", "hot", "cooling", "threads", "seed" } },
+                { "parallel_tempering", { "width", "height", "exchanges", "iterations", "cold", "hot", "replicas", "threads", "seed" } },
+                { "qp", { "width", "height", "method", "levels", "phases", "solver", "tolerance", "max_iterations", "threads",
+                          "refine", "refine_iterations", "refine_temperatures", "hot", "cooling" } }
+            };
+            return params;
+        }
+
+        bool is_array(const ptree &node) {
+            return !node.empty() && std::all_of(node.begin(), node.end(),
+                [](const ptree::value_type &child) { return child.first.empty(); });
+        }
+
+        std::vector<std::string> values_of(const ptree &node) {
+            std::vector<std::string> values;
+            if (is_array(node)) {
+                for (const auto &child : node) values.push_back(child.second.data());
+            }
+            else {
+                values.push_back(node.data());
+            }
+            return values;
+        }
+
+        std::vector<std::string> netlist_names(const ptree &spec) {
+            std::vector<std::string> names;
+            for (const auto &entry : spec.get_child("netlists")) {
+                names.push_back(entry.second.get<std::string>("name"));
+            }
+            return names;
+        }
+
+        std::vector<experiment_run> expand_experiments(const ptree &spec) {
+            std::vector<std::string> all_netlists = netlist_names(spec);
+            std::vector<experiment_run> runs;
+
+            for (const auto &entry : spec.get_child("experiments")) {
+                const ptree &exp = entry.second;
+                std::string engine = exp.get<std::string>("engine");
+                auto allowed = engine_params().find(engine);
+                if (allowed == engine_params().end()) throw std::runtime_error{ "unknown engine " + engine };
+
+                std::vector<std::string> netlists = all_netlists;
+                std::vector<std::pair<std::string, std::vector<std::string>>> axes;
+                for (const auto &param : exp) {
+                    if (param.first == "engine") continue;
+                    if (param.first == "netlists") {
+                        netlists = values_of(param.second);
+                        for (const std::string &name : netlists) {
+                            if (std::find(all_netlists.begin(), all_netlists.end(), name) == all_netlists.end()) {
+                                throw std::runtime_error{ "unknown netlist " + name };
+                            }
+                        }
+                        continue;
+                    }
+                    if (allowed->second.count(param.first) == 0) {
+                        throw std::runtime_error{ "engine " + engine + " has no parameter " + param.first };
+                    }
+                    axes.emplace_back(param.first, values_of(param.second));
+                }
+
+                // Odometer over the axes, the last parameter varying fastest.
+                for (const std::string &netlist : netlists) {
+                    std::vector<std::size_t> digits(axes.size(), 0);
+                    bool done = false;
+                    while (!done) {
+                        experiment_run run{ runs.size(), netlist, engine, {} };
+                        for (std::size_t a = 0; a < axes.size(); ++a) {
+                            run.params.emplace_back(axes[a].first, axes[a].second[digits[a]]);
+                        }
+                        runs.push_back(std::move(run));
+
+                        done = true;
+                        for (std::size_t a = axes.size(); a-- > 0;) {
+                            if (++digits[a] < axes[a].second.size()) {
+                                done = false;
+                                break;
+                            }
+                            digits[a] = 0;
+                        }
+                    }
+                }
+            }
+
+            return runs;
+        }
+
+        class run_params {
+
+        public:
+
+            run_params(const experiment_run &run)
+                :m_run{ run }
+            {}
+
+            template <typename T>
+            T get(const std::string &key, T fallback) const {
+                for (const auto &param : m_run.params) {
+                    if (param.first == key) return boost::lexical_cast<T>(param.second);
+                }
+                return fallback;
+            }
+
+            std::string get(const std::string &key, const char* fallback) const {
+                return get<std::string>(key, fallback);
+            }
+
+        private:
+
+            const experiment_run &m_run;
+
+        };
+
+        template <>
+        bool run_params::get<bool>(const std::string &key, bool fallback) const {
+            std::string value = get<std::string>(key, fallback ? "true" : "false");
+            if (value == "true" || value == "1") return true;
+            if (value == "false" || value == "0") return false;
+            throw std::runtime_error{ "parameter " + key + " is not a boolean: " + value };
+        }
+
+        Netlist load_netlist(const ptree &entry) {
+            if (auto path = entry.get_optional<std::string>("blif")) return read_blif(*path);
+            if (auto path = entry.get_optional<std::string>("binary")) return load_binary_netlist(*path);
+
+            const ptree &random = entry.get_child("random");
+            std::size_t num_ipins = random.get<std::size_t>("ipins");
+            std::size_t num_opins = random.get<std::size_t>("opins");
+            std::size_t num_luts = random.get<std::size_t>("luts");
+            std::size_t num_ffs = random.get<std::size_t>("ffs");
+            std::size_t num_inputs = random.get<std::size_t>("inputs", 3);
+            std::size_t num_outputs = random.get<std::size_t>("outputs", 3);
+            std::size_t num_phases = random.get<std::size_t>("phases", 1);
+            if (auto seed = random.get_optional<std::uint64_t>("seed")) {
+                return parallel_random_netlist(num_ipins, num_opins, num_luts, num_ffs, num_inputs, num_outputs, num_phases,
+                                               random.get<std::size_t>("threads", 1), *seed);
+            }
+            return random_netlist(num_ipins, num_opins, num_luts, num_ffs, num_inputs, num_outputs, num_phases);
+        }
+
+        std::size_t default_side(const Netlist &netlist) {
+            return static_cast<std::size_t>(std::ceil(std::sqrt(5.0 * (netlist.num_luts() + netlist.num_ffs()))));
+        }
+
+        Plan::partitioning_method parse_method(const std::string &method) {
+            if (method == "adaptive") return Plan::partitioning_method::adaptive;
+            if (method == "bisection") return Plan::partitioning_method::bisection;
+            throw std::runtime_error{ "unknown partitioning method " + method };
+        }
+
+        qp_solver parse_solver(const std::string &solver) {
+            if (solver == "direct") return qp_solver::direct;
+            if (solver == "cg_jacobi") return qp_solver::conjugate_gradient_jacobi;
+            if (solver == "cg_ichol") return qp_solver::conjugate_gradient_ichol;
+            throw std::runtime_error{ "unknown solver " + solver };
+        }
+
+        void fixed_annealing(Chip &chip, const run_params &params, std::int64_t num_moves, std::size_t num_temperatures) {
+            simulated_annealing(chip, num_temperatures, num_moves / num_temperatures, params.get("hot", 0.5), params.get("cooling", 0.5));
+        }
+
+        // Runs one engine on a private copy of the shared initial chip and returns the final bbox.
+        std::int64_t run_engine(const experiment_run &run, const Netlist &netlist, const Chip &initial) {
+            run_params params{ run };
+
+            if (run.engine == "random") {
+                Chip chip{ initial.clone() };
+                random_placement(chip, params.get<std::int64_t>("iterations", 10'000));
+                return chip.get_bbox();
+            }
+            if (run.engine == "sa") {
+                Chip chip{ initial.clone() };
+                fixed_annealing(chip, params, params.get<std::int64_t>("iterations", 10'000), params.get<std::size_t>("temperatures", 5));
+                return chip.get_bbox();
+            }
+            if (run.engine == "sa_adaptive") {
+                anneal_schedule schedule;
+                schedule.moves_per_atom = params.get("moves_per_atom", schedule.moves_per_atom);
+                schedule.initial_temperature_factor = params.get("initial_temperature_factor", schedule.initial_temperature_factor);
+                schedule.exit_temperature_factor = params.get("exit_temperature_factor", schedule.exit_temperature_factor);
+                schedule.improvement_tolerance = params.get("improvement_tolerance", schedule.improvement_tolerance);
+                schedule.max_stalled_temperatures = params.get("max_stalled_temperatures", schedule.max_stalled_temperatures);
+                schedule.range_limited = params.get("range_limited", schedule.range_limited);
+
+                Chip chip{ initial.clone() };
+                simulated_annealing(chip, schedule, params.get<std::uint64_t>("seed", 0));
+                return chip.get_bbox();
+            }
+            if (run.engine == "parallel_sa") {
+                std::size_t num_temperatures = params.get<std::size_t>("temperatures", 5);
+                Chip chip{ initial.clone() };
+                parallel_simulated_annealing(chip, num_temperatures, params.get<std::size_t>("iterations", 10'000) / num_temperatures,
+                    params.get("hot", 0.5), params.get("cooling", 0.5), params.get<std::size_t>("threads", 1),
+                    params.get<std::uint64_t>("seed", 0));
+                return chip.get_bbox();
+            }
+            if (run.engine == "parallel_tempering") {
+                Chip best = parallel_tempering(initial, params.get<std::int64_t>("exchanges", 10), params.get<std::size_t>("iterations", 1'000),
+                    params.get("cold", 0.05), params.get("hot", 5.0), params.get<std::size_t>("replicas", 4),
+                    params.get<std::size_t>("threads", 1), params.get<std::uint64_t>("seed", 0));
+                return best.get_bbox();
+            }
+
+            qp_options options;
+            options.solver = parse_solver(params.get("solver", "direct"));
+            options.tolerance = params.get("tolerance", options.tolerance);
+            options.max_iterations = params.get("max_iterations", options.max_iterations);
+            options.num_threads = params.get<std::size_t>("threads", 1);
+
+            Plan plan{ quadratic_placement(initial.get_width(), initial.get_height(), netlist, params.get("levels", 2),
+                parse_method(params.get("method", "adaptive")), params.get<std::size_t>("phases", 1), nullptr, options) };
+            Chip chip{ plan };
+
+            std::string refine = params.get("refine", "none");
+            if (refine == "random") {
+                random_placement(chip, params.get<std::int64_t>("refine_iterations", 10'000));
+            }
+            else if (refine == "sa") {
+                fixed_annealing(chip, params, params.get<std::int64_t>("refine_iterations", 10'000), params.get<std::size_t>("refine_temperatures", 5));
+            }
+            else if (refine != "none") {
+                throw std::runtime_error{ "unknown refinement " + refine };
+            }
+            return chip.get_bbox();
+        }
+
+        std::string json_quote(const std::string &value) {
+            std::ostringstream os;
+            os << '"';
+            for (char c : value) {
+                if (c == '"' || c == '\\') os << '\\' << c;
+                else if (static_cast<unsigned char>(c) < 0x20) os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+                else os << c;
+            }
+            os << '"';
+            return os.str();
+        }
+
+        // Spec values are kept as text. Numbers and booleans are written back bare, anything else
+        // as a string.
+        std::string json_value(const std::string &value) {
+            if (value == "true" || value == "false") return value;
+            if (!value.empty() && (std::isdigit(static_cast<unsigned char>(value[0])) || value[0] == '-')) {
+                char* end = nullptr;
+                std::strtod(value.c_str(), &end);
+                if (*end == '\0') return value;
+            }
+            return json_quote(value);
+        }
+
+        // Stats shards, perf stages and trace spans belong to threads rather than to runs, so runs
+        // go one at a time while any of them is collected. Each engine still uses its own threads.
+        bool serialize_runs() {
+#if defined(PLACER_ENABLE_STATS) || defined(PLACER_ENABLE_PERF_COUNTERS)
+            return true;
+#else
+            return trace::enabled();
+#endif
+        }
+
+        // Results arrive in any order but are written in run order, each as soon as every run
+        // before it has been written.
+        class ordered_writer {
+
+        public:
+
+            ordered_writer(std::ostream &os, std::size_t num_runs)
+                :m_os{ os },
+                m_lines(num_runs),
+                m_ready(num_runs, false),
+                m_next{ 0 }
+            {}
+
+            void write(std::size_t index, std::string line) {
+                std::lock_guard<std::mutex> lock{ m_mutex };
+                m_lines[index] = std::move(line);
+                m_ready[index] = true;
+                while (m_next < m_lines.size() && m_ready[m_next]) {
+                    m_os << m_lines[m_next];
+                    m_lines[m_next].clear();
+                    ++m_next;
+                }
+                m_os.flush();
+            }
+
+        private:
+
+            std::ostream &m_os;
+            std::vector<std::string> m_lines;
+            std::vector<bool> m_ready;
+            std::size_t m_next;
+            std::mutex m_mutex;
+
+        };
+
+    }
+
+    std::vector<experiment_run> expand_experiments(const std::string &spec_filepath) {
+        impl::ptree spec;
+        boost::property_tree::read_json(spec_filepath, spec);
+        return impl::expand_experiments(spec);
+    }
+
+    void run_experiments(const std::string &spec_filepath, std::ostream &os) {
+        impl::ptree spec;
+        boost::property_tree::read_json(spec_filepath, spec);
+        std::vector<experiment_run> runs = impl::expand_experiments(spec);
+
+        thread_pool pool{ spec.get<std::size_t>("threads", std::max(1u, std::thread::hardware_concurrency())) };
+
+        std::vector<const impl::ptree*> entries;
+        for (const auto &entry : spec.get_child("netlists")) entries.push_back(&entry.second);
+        std::vector<std::unique_ptr<Netlist>> netlists(entries.size());
+        pool.parallel_for(0, entries.size(), [&](std::size_t i) {
+            netlists[i] = std::make_unique<Netlist>(impl::load_netlist(*entries[i]));
+        });
+
+        std::vector<std::string> names = impl::netlist_names(spec);
+        auto netlist_of = [&](const experiment_run &run) {
+            return static_cast<std::size_t>(std::find(names.begin(), names.end(), run.netlist) - names.begin());
+        };
+
+        // Every run starts from the initial placement of its (netlist, width, height), built once
+        // and cloned by the engines.
+        using chip_key = std::tuple<std::size_t, std::size_t, std::size_t>;
+        std::map<chip_key, std::size_t> chip_index;
+        std::vector<chip_key> chip_keys;
+        std::vector<std::size_t> run_chip;
+        for (const experiment_run &run : runs) {
+            impl::run_params params{ run };
+            std::size_t n = netlist_of(run);
+            std::size_t side = impl::default_side(*netlists[n]);
+            chip_key key{ n, params.get("width", side), params.get("height", side) };
+            auto inserted = chip_index.emplace(key, chip_keys.size());
+            if (inserted.second) chip_keys.push_back(key);
+            run_chip.push_back(inserted.first->second);
+        }
+
+        std::vector<std::unique_ptr<Chip>> chips(chip_keys.size());
+        std::vector<std::string> chip_errors(chip_keys.size());
+        pool.parallel_for(0, chip_keys.size(), [&](std::size_t i) {
+            try {
+                chips[i] = std::make_unique<Chip>(std::get<1>(chip_keys[i]), std::get<2>(chip_keys[i]), *netlists[std::get<0>(chip_keys[i])]);
+            }
+            catch (const std::exception &e) {
+                chip_errors[i] = e.what();
+            }
+        });
+
+        impl::ordered_writer writer{ os, runs.size() };
+        auto run_one = [&](const experiment_run &run) {
+            std::size_t c = run_chip[run.index];
+            std::ostringstream line;
+            line << "{\"run\":" << run.index << ",\"netlist\":" << impl::json_quote(run.netlist)
+                 << ",\"engine\":" << impl::json_quote(run.engine) << ",\"params\":{";
+            for (std::size_t p = 0; p < run.params.size(); ++p) {
+                line << (p == 0 ? "" : ",") << impl::json_quote(run.params[p].first) << ":" << impl::json_value(run.params[p].second);
+            }
+            line << "},\"width\":" << std::get<1>(chip_keys[c]) << ",\"height\":" << std::get<2>(chip_keys[c]);
+
+            try {
+                if (!chip_errors[c].empty()) throw std::runtime_error{ chip_errors[c] };
+                auto start = std::chrono::steady_clock::now();
+                std::int64_t bbox = impl::run_engine(run, *netlists[std::get<0>(chip_keys[c])], *chips[c]);
+                auto elapsed = std::chrono::steady_clock::now() - start;
+
+                line << ",\"initial_bbox\":" << chips[c]->get_bbox() << ",\"bbox\":" << bbox
+                     << ",\"seconds\":" << std::chrono::duration<double>(elapsed).count() << "}\n";
+            }
+            catch (const std::exception &e) {
+                line << ",\"error\":" << impl::json_quote(e.what()) << "}\n";
+            }
+
+            writer.write(run.index, line.str());
+        };
+
+        if (impl::serialize_runs()) {
+            for (const experiment_run &run : runs) run_one(run);
+            return;
+        }
+
+        thread_pool::task_group group;
+        for (const experiment_run &run : runs) {
+            pool.run(group, [&]() { run_one(run); });
+        }
+        pool.wait(group);
+    }
+
+}
\ No newline at end of file
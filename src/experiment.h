@@ -0,0 +1,33 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Utils {
+
+    // One point of a parameter sweep: the netlist and engine to run and every parameter given for
+    // it, in the order they appear in the spec.
+    struct experiment_run {
+        std::size_t index;
+        std::string netlist;
+        std::string engine;
+        std::vector<std::pair<std::string, std::string>> params;
+    };
+
+    // A JSON spec lists "netlists" (each named, from "random", "blif" or "binary"), "experiments"
+    // and optionally "threads". An experiment names an "engine" and the netlists it runs on, and
+    // every parameter given as an array is swept; the runs are the cartesian product of all
+    // arrays. src/sample_spec.json shows every engine and its parameters.
+    std::vector<experiment_run> expand_experiments(const std::string &spec_filepath);
+
+    // Loads the netlists once, runs every experiment on a thread pool sharing them read-only and
+    // writes one JSON object per run, in run order, to os. Runs go one at a time instead when
+    // stats, perf counters or tracing are enabled, so their reports are not mixed across runs.
+    void run_experiments(const std::string &spec_filepath, std::ostream &os);
+
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#include "flat_netlist.h"
+
+constexpr FlatNetlist::id_type FlatNetlist::invalid_id;
+
+FlatNetlist::FlatNetlist(const Netlist &netlist)
+    :m_netlist{ netlist },
+    m_lut_base{ Utils::Access::get_luts(netlist).data() },
+    m_ff_base{ Utils::Access::get_ffs(netlist).data() },
+    m_ipin_base{ Utils::Access::get_ipins(netlist).data() },
+    m_opin_base{ Utils::Access::get_opins(netlist).data() },
+    m_ff_begin{ static_cast<id_type>(netlist.num_luts()) },
+    m_ipin_begin{ static_cast<id_type>(netlist.num_luts() + netlist.num_ffs()) },
+    m_opin_begin{ static_cast<id_type>(netlist.num_luts() + netlist.num_ffs() + netlist.num_ipins()) }
+{
+    std::size_t total = netlist.num_luts() + netlist.num_ffs() + netlist.num_ipins() + netlist.num_opins();
+    RUNTIME_ASSERT(total < invalid_id);
+
+    m_atoms.reserve(total);
+    for (const Atom &lut : netlist.luts()) m_atoms.push_back(&lut);
+    for (const Atom &ff : netlist.ffs()) m_atoms.push_back(&ff);
+    for (const IPin &ipin : netlist.ipins()) m_atoms.push_back(&ipin);
+    for (const OPin &opin : netlist.opins()) m_atoms.push_back(&opin);
+
+    m_driven_offsets.reserve(total + 1);
+    m_driven_offsets.push_back(0);
+    for (const Atom* atom : m_atoms) {
+        m_driven_offsets.push_back(m_driven_offsets.back() + static_cast<id_type>(atom->outputs().size()));
+    }
+
+    std::size_t num_nets = m_driven_offsets.back();
+    m_net_offsets.reserve(num_nets + 1);
+    m_net_offsets.push_back(0);
+    m_net_weights.reserve(num_nets);
+    for (id_type id = 0; id < m_atoms.size(); ++id) {
+        for (const OPort &oport : m_atoms[id]->outputs()) {
+            m_net_pins.push_back(id);
+            for (const IPort* iport : oport) {
+                m_net_pins.push_back(atom_id(iport->get_atom()));
+            }
+            m_net_offsets.push_back(static_cast<id_type>(m_net_pins.size()));
+            m_net_weights.push_back(oport.empty() ? 0.0 : 1.0 / oport.size());
+        }
+    }
+
+    m_fanin_offsets.reserve(total + 1);
+    m_fanin_offsets.push_back(0);
+    for (const Atom* atom : m_atoms) {
+        for (const IPort &iport : atom->inputs()) {
+            if (iport.has_fanin()) m_fanin_nets.push_back(net_id(*iport.fanin()));
+        }
+        m_fanin_offsets.push_back(static_cast<id_type>(m_fanin_nets.size()));
+    }
+}
\ No newline at end of file
@@ -0,0 +1,116 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#pragma once
+
+#include <boost/range/irange.hpp>
+#include <cstdint>
+#include <limits>
+
+#include "netlist.h"
+
+// Immutable CSR view of a Netlist. Atoms get dense ids (LUTs, then FFs, then IPins, then
+// OPins) and every OPort becomes a net. Nets are numbered atom by atom, so the nets driven
+// by an atom form a contiguous id range. The first pin of a net is its driver.
+class FlatNetlist {
+
+public:
+
+    using id_type = std::uint32_t;
+
+    static constexpr id_type invalid_id = std::numeric_limits<id_type>::max();
+
+    explicit FlatNetlist(const Netlist &netlist);
+
+    FlatNetlist(const FlatNetlist&) = delete;
+    FlatNetlist &operator=(const FlatNetlist&) = delete;
+
+    inline const Netlist &get_netlist() const { return m_netlist; }
+
+    inline std::size_t num_atoms() const { return m_atoms.size(); }
+    inline std::size_t num_cells() const { return m_ipin_begin; }
+    inline std::size_t num_nets() const { return m_net_offsets.size() - 1; }
+
+    inline id_type ipin_begin() const { return m_ipin_begin; }
+    inline id_type opin_begin() const { return m_opin_begin; }
+
+    inline bool is_cell(id_type id) const { return id < m_ipin_begin; }
+    inline bool is_ipin(id_type id) const { return id >= m_ipin_begin && id < m_opin_begin; }
+    inline bool is_opin(id_type id) const { return id >= m_opin_begin; }
+
+    inline Atom::type get_type(id_type id) const { return m_atoms[id]->get_type(); }
+    inline const Atom &get_atom(id_type id) const { return *m_atoms[id]; }
+
+    inline id_type atom_id(const Atom &atom) const {
+        std::size_t id = 0;
+        switch (atom.get_type()) {
+        case Atom::type::LUT:
+            id = &atom - m_lut_base;
+            break;
+        case Atom::type::FF:
+            id = m_ff_begin + (&atom - m_ff_base);
+            break;
+        case Atom::type::IPIN:
+            id = m_ipin_begin + (static_cast<const IPin*>(&atom) - m_ipin_base);
+            break;
+        case Atom::type::OPIN:
+            id = m_opin_begin + (static_cast<const OPin*>(&atom) - m_opin_base);
+            break;
+        }
+        RUNTIME_ASSERT(id < m_atoms.size() && m_atoms[id] == &atom);
+        return static_cast<id_type>(id);
+    }
+
+    inline id_type net_id(const OPort &oport) const {
+        const Atom &atom = oport.get_atom();
+        return m_driven_offsets[atom_id(atom)] + static_cast<id_type>(&oport - &*atom.begin_outputs());
+    }
+
+    inline auto net_pins(id_type net) const {
+        return boost::make_iterator_range(m_net_pins.data() + m_net_offsets[net],
+                                          m_net_pins.data() + m_net_offsets[net + 1]);
+    }
+
+    inline auto net_sinks(id_type net) const {
+        return boost::make_iterator_range(m_net_pins.data() + m_net_offsets[net] + 1,
+                                          m_net_pins.data() + m_net_offsets[net + 1]);
+    }
+
+    inline id_type net_driver(id_type net) const { return m_net_pins[m_net_offsets[net]]; }
+    inline std::size_t net_degree(id_type net) const { return m_net_offsets[net + 1] - m_net_offsets[net]; }
+    inline std::size_t net_fanout(id_type net) const { return net_degree(net) - 1; }
+    inline double net_weight(id_type net) const { return m_net_weights[net]; }
+
+    inline auto driven_nets(id_type atom) const {
+        return boost::irange(m_driven_offsets[atom], m_driven_offsets[atom + 1]);
+    }
+
+    inline auto fanin_nets(id_type atom) const {
+        return boost::make_iterator_range(m_fanin_nets.data() + m_fanin_offsets[atom],
+                                          m_fanin_nets.data() + m_fanin_offsets[atom + 1]);
+    }
+
+private:
+
+    const Netlist &m_netlist;
+
+    const Atom* m_lut_base;
+    const Atom* m_ff_base;
+    const IPin* m_ipin_base;
+    const OPin* m_opin_base;
+
+    id_type m_ff_begin;
+    id_type m_ipin_begin;
+    id_type m_opin_begin;
+
+    std::vector<const Atom*> m_atoms;
+
+    std::vector<id_type> m_net_offsets;
+    std::vector<id_type> m_net_pins;
+    std::vector<double> m_net_weights;
+
+    std::vector<id_type> m_driven_offsets;
+    std::vector<id_type> m_fanin_offsets;
+    std::vector<id_type> m_fanin_nets;
+
+};
\ No newline at end of file
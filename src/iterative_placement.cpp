@@ -1,93 +1,352 @@
 // (C) Copyright Shou Hao Ho   2018
 // Distributed under the MIT Software License (See accompanying LICENSE file)
 
+#include <cmath>
 #include <random>
 #include "placement.h"
+#include "move_generator.h"
+#include "perf_counters.h"
+#include "stats.h"
+#include "trace.h"
 
 namespace Utils {
 
-    void dump_chip(const Chip &chip, std::ostream &os) {
-        for (const auto &entry : chip.coords()) {
-            os << "(" << entry.x << "," << entry.y << ")\n";
+    namespace impl {
+
+        double initial_temperature(const Chip &chip, std::mt19937 &eng, std::size_t num_samples, double factor) {
+            move_generator moves{ chip };
+            double sum = 0.0;
+            double sum_sq = 0.0;
+            for (std::size_t i = 0; i < num_samples; ++i) {
+                const Atom &atom = moves.atom(eng);
+                double delta = static_cast<double>(chip.evaluate_swap(atom, moves.site(eng)));
+                sum += delta;
+                sum_sq += delta * delta;
+            }
+
+            double mean = sum / num_samples;
+            double variance = std::max(0.0, sum_sq / num_samples - mean * mean);
+            return factor * std::sqrt(variance);
         }
-    }
 
-    void random_placement(Chip &chip, std::int64_t num_iter, metric_consumer* met) {
-        std::mt19937 eng;
-        std::bernoulli_distribution type_dist;
+        double cooling_factor(double acceptance_rate) {
+            if (acceptance_rate > 0.96) return 0.5;
+            if (acceptance_rate > 0.8) return 0.9;
+            if (acceptance_rate > 0.15) return 0.95;
+            return 0.8;
+        }
+
+        std::int64_t update_range_limit(std::int64_t rlim, double acceptance_rate, std::int64_t max_rlim) {
+            double next = std::round(rlim * (1.0 - 0.44 + acceptance_rate));
+            return std::max<std::int64_t>(1, std::min(max_rlim, static_cast<std::int64_t>(next)));
+        }
 
-        std::uniform_int_distribution<std::size_t> chip_dist{ 0, chip.get_width()*chip.get_height()/2 - 1 };
-        std::uniform_int_distribution<std::size_t> lut_dist{ 0, chip.get_netlist().num_luts() - 1 };
-        std::uniform_int_distribution<std::size_t> ff_dist{ 0, chip.get_netlist().num_ffs() - 1 };
+        // The move loops check whether a checkpoint is due only this often, keeping the clock off
+        // the per-move path.
+        constexpr std::int64_t checkpoint_stride = 4096;
 
-        if (met != nullptr) {
-            met->snapshot() << "ss " << 0 << " (" << chip.get_width() << "," << chip.get_height() << "):\n";
-            dump_chip(chip, met->snapshot());
+        std::unique_ptr<anneal_checkpoint> snapshot(const Chip &chip, checkpoint_kind kind, std::int64_t iteration, const std::mt19937 &eng) {
+            auto checkpoint = std::make_unique<anneal_checkpoint>();
+            checkpoint->kind = kind;
+            checkpoint->width = chip.get_width();
+            checkpoint->height = chip.get_height();
+            checkpoint->iteration = iteration;
+            checkpoint->bbox = chip.get_bbox();
+            checkpoint->engine = eng;
+            checkpoint->sites = chip.sites();
+            return checkpoint;
         }
 
-        for (std::int64_t i = 0; i < num_iter; ++i) {
-            std::int64_t prev_bbox = chip.get_bbox();
+        anneal_checkpoint restore(Chip &chip, checkpoint_kind kind, const std::string &filepath) {
+            anneal_checkpoint checkpoint = load_checkpoint(filepath);
+            RUNTIME_ASSERT(checkpoint.kind == kind);
+            RUNTIME_ASSERT(checkpoint.width == chip.get_width() && checkpoint.height == chip.get_height());
+            chip.restore_sites(checkpoint.sites);
+            RUNTIME_ASSERT(chip.get_bbox() == checkpoint.bbox);
+            return checkpoint;
+        }
+
+        void run_random_placement(Chip &chip, std::int64_t num_iter, std::int64_t first_iter, std::mt19937 &eng,
+            const checkpoint_options &checkpoint, metric_consumer* met)
+        {
+            checkpoint_writer writer{ checkpoint };
+            move_generator moves{ chip };
+            Chip::pending_swap pending;
+
             if (met != nullptr) {
-                met->iter() << prev_bbox << "\n";
+                met->snapshot() << "ss " << 0 << " (" << chip.get_width() << "," << chip.get_height() << "):\n";
+                dump_chip(chip, met->snapshot());
             }
 
-            const Atom &atom_to_swap = type_dist(eng) ? get<Netlist::LUT>(chip.get_netlist(), lut_dist(eng)) :
-                                                        get<Netlist::FF>(chip.get_netlist(), ff_dist(eng));
-            std::size_t new_idx = chip_dist(eng);
-            std::size_t prev_idx = chip.swap(atom_to_swap, new_idx);
+            for (std::int64_t i = first_iter; i < num_iter; ++i) {
+                std::int64_t prev_bbox = chip.get_bbox();
+
+                const Atom &atom_to_swap = moves.atom(eng);
+                std::size_t new_idx = moves.site(eng);
+
+                bool accepted = chip.evaluate_swap(atom_to_swap, new_idx, pending) <= 0;
+                if (accepted) {
+                    chip.commit(pending);
+                    PLACER_STATS_ADD(random_accepted, 1);
+                }
+
+                if (met != nullptr) {
+                    met->record(prev_bbox, accepted);
+                }
 
-            if (chip.get_bbox() > prev_bbox) {
-                chip.swap(atom_to_swap, prev_idx);
+                if ((i + 1) % checkpoint_stride == 0 && writer.due()) {
+                    writer.submit(snapshot(chip, checkpoint_kind::random_placement, i + 1, eng));
+                }
             }
-        }
 
-        if (met != nullptr) {
-            met->snapshot() << "ss " << 0 << " (" << chip.get_width() << "," << chip.get_height() << "):\n";
-            dump_chip(chip, met->snapshot());
+            PLACER_STATS_ADD(random_moves, std::max<std::int64_t>(0, num_iter - first_iter));
+
+            if (writer.enabled()) {
+                writer.submit(snapshot(chip, checkpoint_kind::random_placement, std::max(first_iter, num_iter), eng));
+            }
+            writer.finish();
+
+            if (met != nullptr) {
+                met->snapshot() << "ss " << 0 << " (" << chip.get_width() << "," << chip.get_height() << "):\n";
+                dump_chip(chip, met->snapshot());
+            }
         }
-    }
 
-    void simulated_annealing(Chip &chip, std::int64_t num_iter, std::size_t num_swap_per_temperature, double hot, double cooling_factor, metric_consumer* met) {
-        std::mt19937 eng;
-        std::bernoulli_distribution type_dist;
+        void run_simulated_annealing(Chip &chip, std::int64_t num_iter, std::size_t num_swap_per_temperature, double temperature,
+            double cooling_factor, std::int64_t first_iter, std::size_t first_move, std::mt19937 &eng, const checkpoint_options &checkpoint,
+            metric_consumer* met)
+        {
+            checkpoint_writer writer{ checkpoint };
+            move_generator moves{ chip };
+            Chip::pending_swap pending;
 
-        std::uniform_int_distribution<std::size_t> chip_dist{ 0, chip.get_width()*chip.get_height() / 2 - 1 };
-        std::uniform_int_distribution<std::size_t> lut_dist{ 0, chip.get_netlist().num_luts() - 1 };
-        std::uniform_int_distribution<std::size_t> ff_dist{ 0, chip.get_netlist().num_ffs() - 1 };
-        std::uniform_real_distribution<double> unif{ 0.0, 1.0 };
+            if (met != nullptr) {
+                met->snapshot() << "ss " << 0 << " (" << chip.get_width() << "," << chip.get_height() << "):\n";
+                dump_chip(chip, met->snapshot());
+            }
 
-        if (met != nullptr) {
-            met->snapshot() << "ss " << 0 << " (" << chip.get_width() << "," << chip.get_height() << "):\n";
-            dump_chip(chip, met->snapshot());
-        }
+            for (std::int64_t i = first_iter; i < num_iter; ++i) {
+                PLACER_TRACE_SPAN_ARG("sa_temperature", "temperature", temperature);
+                PLACER_PERF_STAGE(sa_temperature);
+                PLACER_STATS_TIMER(sa_temperature);
+                std::size_t first = i == first_iter ? first_move : 0;
+                for (std::size_t j = first; j < num_swap_per_temperature; ++j) {
+                    std::int64_t prev_bbox = chip.get_bbox();
 
-        double temperature = hot;
-        for (std::int64_t i = 0; i < num_iter; ++i) {
-            for (std::size_t j = 0; j < num_swap_per_temperature; ++j) {
-                std::int64_t prev_bbox = chip.get_bbox();
-                if (met != nullptr) {
-                    met->iter() << prev_bbox << "\n";
+                    const Atom &atom_to_swap = moves.atom(eng);
+                    std::size_t new_idx = moves.site(eng);
+                    std::int64_t delta = chip.evaluate_swap(atom_to_swap, new_idx, pending);
+
+                    bool accepted = metropolis_accept(delta, temperature, eng);
+                    if (accepted) {
+                        chip.commit(pending);
+                        PLACER_STATS_ADD(sa_accepted, 1);
+                    }
+
+                    if (met != nullptr) {
+                        met->record(prev_bbox, accepted);
+                    }
+
+                    // The last move of a temperature is left to the checkpoint after cooling
+                    if ((j + 1) % checkpoint_stride == 0 && j + 1 < num_swap_per_temperature && writer.due()) {
+                        auto state = snapshot(chip, checkpoint_kind::simulated_annealing, i, eng);
+                        state->move = static_cast<std::int64_t>(j + 1);
+                        state->temperature = temperature;
+                        writer.submit(std::move(state));
+                    }
+                }
+
+                PLACER_STATS_ADD(sa_moves, num_swap_per_temperature - first);
+                PLACER_STATS_ADD(sa_temperatures, 1);
+                temperature *= cooling_factor;
+
+                if (writer.due()) {
+                    auto state = snapshot(chip, checkpoint_kind::simulated_annealing, i + 1, eng);
+                    state->temperature = temperature;
+                    writer.submit(std::move(state));
                 }
+            }
+
+            if (writer.enabled()) {
+                auto state = snapshot(chip, checkpoint_kind::simulated_annealing, std::max(first_iter, num_iter), eng);
+                state->move = num_iter > first_iter ? 0 : static_cast<std::int64_t>(first_move);
+                state->temperature = temperature;
+                writer.submit(std::move(state));
+            }
+            writer.finish();
+
+            if (met != nullptr) {
+                met->snapshot() << "ss " << 0 << " (" << chip.get_width() << "," << chip.get_height() << "):\n";
+                dump_chip(chip, met->snapshot());
+            }
+        }
+
+        struct adaptive_state {
+            std::int64_t iteration;
+            double temperature;
+            std::size_t num_stalled;
+            std::int64_t rlim;
+        };
+
+        void run_adaptive_annealing(Chip &chip, const anneal_schedule &schedule, adaptive_state state, std::mt19937 &eng,
+            const checkpoint_options &checkpoint, metric_consumer* met)
+        {
+            checkpoint_writer writer{ checkpoint };
+            move_generator moves{ chip };
+            Chip::pending_swap pending;
+
+            std::size_t num_atoms = chip.get_netlist().num_luts() + chip.get_netlist().num_ffs();
+            std::size_t num_nets = std::max<std::size_t>(1, chip.get_flat_netlist().num_nets());
+            std::size_t num_moves = std::max<std::size_t>(1, static_cast<std::size_t>(
+                schedule.moves_per_atom * std::pow(static_cast<double>(num_atoms), 4.0 / 3.0)));
+            std::int64_t max_rlim = static_cast<std::int64_t>(std::max(chip.get_width(), chip.get_height()));
+
+            double temperature = state.temperature;
+            std::size_t num_stalled = state.num_stalled;
+            std::int64_t rlim = state.rlim;
+            std::int64_t iteration = state.iteration;
 
-                const Atom &atom_to_swap = type_dist(eng) ? get<Netlist::LUT>(chip.get_netlist(), lut_dist(eng)) :
-                    get<Netlist::FF>(chip.get_netlist(), ff_dist(eng));
-                std::size_t new_idx = chip_dist(eng);
-                std::size_t prev_idx = chip.swap(atom_to_swap, new_idx);
+            auto save = [&]() {
+                auto saved = snapshot(chip, checkpoint_kind::adaptive_annealing, iteration, eng);
+                saved->temperature = temperature;
+                saved->num_stalled = num_stalled;
+                saved->range_limit = rlim;
+                writer.submit(std::move(saved));
+            };
 
-                if (chip.get_bbox() > prev_bbox &&
-                    unif(eng) >= std::exp(static_cast<double>(prev_bbox - chip.get_bbox()) / temperature))
-                {
-                    chip.swap(atom_to_swap, prev_idx);
+            while (temperature > schedule.exit_temperature_factor * chip.get_bbox() / num_nets &&
+                   num_stalled < schedule.max_stalled_temperatures) {
+                PLACER_TRACE_SPAN_ARG("sa_temperature", "temperature", temperature);
+                PLACER_PERF_STAGE(sa_temperature);
+                PLACER_STATS_TIMER(sa_temperature);
+                std::int64_t start_bbox = chip.get_bbox();
+                std::size_t num_accepted = 0;
+                for (std::size_t j = 0; j < num_moves; ++j) {
+                    std::int64_t prev_bbox = chip.get_bbox();
+
+                    const Atom &atom_to_swap = moves.atom(eng);
+                    std::size_t new_idx = schedule.range_limited ? moves.site_near(atom_to_swap, eng, rlim) : moves.site(eng);
+                    std::int64_t delta = chip.evaluate_swap(atom_to_swap, new_idx, pending);
+
+                    bool accepted = metropolis_accept(delta, temperature, eng);
+                    if (accepted) {
+                        chip.commit(pending);
+                        ++num_accepted;
+                    }
+
+                    if (met != nullptr) {
+                        met->record(prev_bbox, accepted);
+                    }
+                }
+
+                if (std::abs(chip.get_bbox() - start_bbox) > start_bbox * schedule.improvement_tolerance) {
+                    num_stalled = 0;
+                }
+                else {
+                    ++num_stalled;
                 }
+
+                PLACER_STATS_ADD(sa_moves, num_moves);
+                PLACER_STATS_ADD(sa_accepted, num_accepted);
+                PLACER_STATS_ADD(sa_temperatures, 1);
+
+                double acceptance_rate = static_cast<double>(num_accepted) / num_moves;
+                temperature *= cooling_factor(acceptance_rate);
+                rlim = update_range_limit(rlim, acceptance_rate, max_rlim);
+                ++iteration;
+
+                if (writer.due()) save();
+            }
+
+            if (writer.enabled()) save();
+            writer.finish();
+
+            if (met != nullptr) {
+                met->snapshot() << "ss " << 0 << " (" << chip.get_width() << "," << chip.get_height() << "):\n";
+                dump_chip(chip, met->snapshot());
             }
+        }
+
+    }
 
-            temperature *= cooling_factor;
+    void dump_chip(const Chip &chip, std::ostream &os) {
+        for (const auto &entry : chip.coords()) {
+            os << "(" << entry.x << "," << entry.y << ")\n";
         }
+    }
+
+    void random_placement(Chip &chip, std::int64_t num_iter, metric_consumer* met) {
+        random_placement(chip, num_iter, checkpoint_options{}, met);
+    }
+
+    void random_placement(Chip &chip, std::int64_t num_iter, const checkpoint_options &checkpoint, metric_consumer* met) {
+        PLACER_STATS_REPORT_SCOPE(random_placement);
+        PLACER_TRACE_SPAN("random_placement");
+        PLACER_PERF_STAGE(random_placement);
+        std::mt19937 eng;
+        impl::run_random_placement(chip, num_iter, 0, eng, checkpoint, met);
+    }
+
+    void resume_random_placement(Chip &chip, std::int64_t num_iter, const checkpoint_options &checkpoint, metric_consumer* met) {
+        PLACER_STATS_REPORT_SCOPE(random_placement);
+        PLACER_TRACE_SPAN("random_placement");
+        PLACER_PERF_STAGE(random_placement);
+        anneal_checkpoint state = impl::restore(chip, checkpoint_kind::random_placement, checkpoint.filepath);
+        impl::run_random_placement(chip, num_iter, state.iteration, state.engine, checkpoint, met);
+    }
+
+    void simulated_annealing(Chip &chip, std::int64_t num_iter, std::size_t num_swap_per_temperature, double hot, double cooling_factor, metric_consumer* met) {
+        simulated_annealing(chip, num_iter, num_swap_per_temperature, hot, cooling_factor, checkpoint_options{}, met);
+    }
+
+    void simulated_annealing(Chip &chip, std::int64_t num_iter, std::size_t num_swap_per_temperature, double hot, double cooling_factor,
+        const checkpoint_options &checkpoint, metric_consumer* met)
+    {
+        PLACER_STATS_REPORT_SCOPE(simulated_annealing);
+        PLACER_TRACE_SPAN("simulated_annealing");
+        std::mt19937 eng;
+        impl::run_simulated_annealing(chip, num_iter, num_swap_per_temperature, hot, cooling_factor, 0, 0, eng, checkpoint, met);
+    }
+
+    void resume_simulated_annealing(Chip &chip, std::int64_t num_iter, std::size_t num_swap_per_temperature, double cooling_factor,
+        const checkpoint_options &checkpoint, metric_consumer* met)
+    {
+        PLACER_STATS_REPORT_SCOPE(simulated_annealing);
+        PLACER_TRACE_SPAN("simulated_annealing");
+        anneal_checkpoint state = impl::restore(chip, checkpoint_kind::simulated_annealing, checkpoint.filepath);
+        RUNTIME_ASSERT(static_cast<std::uint64_t>(state.move) < num_swap_per_temperature);
+        impl::run_simulated_annealing(chip, num_iter, num_swap_per_temperature, state.temperature, cooling_factor,
+            state.iteration, static_cast<std::size_t>(state.move), state.engine, checkpoint, met);
+    }
 
-        if (met != nullptr) {
-            met->snapshot() << "ss " << 0 << " (" << chip.get_width() << "," << chip.get_height() << "):\n";
-            dump_chip(chip, met->snapshot());
+    void simulated_annealing(Chip &chip, const anneal_schedule &schedule, std::uint64_t seed, metric_consumer* met) {
+        simulated_annealing(chip, schedule, seed, checkpoint_options{}, met);
+    }
+
+    void simulated_annealing(Chip &chip, const anneal_schedule &schedule, std::uint64_t seed, const checkpoint_options &checkpoint,
+        metric_consumer* met)
+    {
+        PLACER_STATS_REPORT_SCOPE(simulated_annealing);
+        PLACER_TRACE_SPAN("simulated_annealing");
+        std::mt19937 eng{ static_cast<std::mt19937::result_type>(seed) };
+        std::size_t num_atoms = chip.get_netlist().num_luts() + chip.get_netlist().num_ffs();
+
+        double temperature;
+        {
+            PLACER_TRACE_SPAN("sa_initial_temperature");
+            temperature = impl::initial_temperature(chip, eng, num_atoms, schedule.initial_temperature_factor);
         }
+        std::int64_t max_rlim = static_cast<std::int64_t>(std::max(chip.get_width(), chip.get_height()));
+
+        impl::run_adaptive_annealing(chip, schedule, impl::adaptive_state{ 0, temperature, 0, max_rlim }, eng, checkpoint, met);
+    }
+
+    void resume_simulated_annealing(Chip &chip, const anneal_schedule &schedule, const checkpoint_options &checkpoint, metric_consumer* met) {
+        PLACER_STATS_REPORT_SCOPE(simulated_annealing);
+        PLACER_TRACE_SPAN("simulated_annealing");
+        anneal_checkpoint state = impl::restore(chip, checkpoint_kind::adaptive_annealing, checkpoint.filepath);
+        impl::run_adaptive_annealing(chip, schedule,
+            impl::adaptive_state{ state.iteration, state.temperature, state.num_stalled, state.range_limit }, state.engine, checkpoint, met);
     }
 
 }
\ No newline at end of file
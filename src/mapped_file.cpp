@@ -0,0 +1,42 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+#include "netlist.h"
+
+namespace Utils {
+
+    mapped_file::mapped_file(const std::string &filepath)
+        :m_data{ nullptr },
+        m_size{ 0 }
+    {
+        int fd = ::open(filepath.c_str(), O_RDONLY);
+        RUNTIME_ASSERT(fd >= 0);
+
+        struct stat st;
+        bool stat_ok = ::fstat(fd, &st) == 0;
+        void* addr = stat_ok && st.st_size > 0 ?
+            ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0) : nullptr;
+        ::close(fd);
+
+        RUNTIME_ASSERT(stat_ok);
+        RUNTIME_ASSERT(addr != MAP_FAILED);
+        if (addr != nullptr) {
+            ::madvise(addr, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+            m_data = static_cast<const char*>(addr);
+            m_size = static_cast<std::size_t>(st.st_size);
+        }
+    }
+
+    mapped_file::~mapped_file() {
+        if (m_data != nullptr) {
+            ::munmap(const_cast<char*>(m_data), m_size);
+        }
+    }
+
+}
\ No newline at end of file
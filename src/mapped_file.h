@@ -0,0 +1,33 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace Utils {
+
+    // Read-only POSIX mapping of a whole file. Pages are shared with every other process mapping
+    // the same file, so parallel jobs reading one netlist share a single page-cached copy.
+    class mapped_file {
+
+    public:
+
+        explicit mapped_file(const std::string &filepath);
+        ~mapped_file();
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file &operator=(const mapped_file&) = delete;
+
+        inline const char* data() const { return m_data; }
+        inline std::size_t size() const { return m_size; }
+
+    private:
+
+        const char* m_data;
+        std::size_t m_size;
+
+    };
+
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#include <limits>
+
+#include "metrics.h"
+
+namespace Utils {
+
+    constexpr std::uint32_t metric_consumer::version;
+    constexpr std::uint32_t metric_consumer::byte_order;
+
+    metric_consumer::metric_consumer(const std::string &iter_filename, const std::string &snapshot_filename,
+        const metric_options &options)
+        :m_options{ options },
+        m_iteration{ 0 },
+        m_last_bbox{ std::numeric_limits<std::int64_t>::min() },
+        m_iteration_stream{ std::make_unique<std::ofstream>(iter_filename, std::ios::out | std::ios::binary) },
+        m_snapshot_stream{ std::make_unique<std::ofstream>(snapshot_filename, std::ios::out | std::ios::binary) },
+        m_stop{ false }
+    {
+        RUNTIME_ASSERT(m_iteration_stream && *m_iteration_stream);
+        RUNTIME_ASSERT(m_snapshot_stream && *m_snapshot_stream);
+        RUNTIME_ASSERT(m_options.decimation > 0 && m_options.buffer_records > 0);
+
+        metric_file_header header{ { 'P', 'L', 'M', 'T' }, version, sizeof(metric_record), byte_order };
+        m_iteration_stream->write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        m_active.reserve(m_options.buffer_records);
+        m_pending.reserve(m_options.buffer_records);
+        m_writer = std::thread{ [this]() { writer_loop(); } };
+    }
+
+    metric_consumer::~metric_consumer() {
+        hand_off();
+        {
+            std::lock_guard<std::mutex> lock{ m_mutex };
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        m_writer.join();
+    }
+
+    void metric_consumer::flush() {
+        hand_off();
+        std::unique_lock<std::mutex> lock{ m_mutex };
+        m_cv.wait(lock, [&]() { return m_pending.empty(); });
+        m_iteration_stream->flush();
+        m_snapshot_stream->flush();
+    }
+
+    void metric_consumer::hand_off() {
+        if (m_active.empty()) return;
+        {
+            std::unique_lock<std::mutex> lock{ m_mutex };
+            m_cv.wait(lock, [&]() { return m_pending.empty(); });
+            m_pending.swap(m_active);
+        }
+        m_cv.notify_all();
+    }
+
+    void metric_consumer::writer_loop() {
+        std::unique_lock<std::mutex> lock{ m_mutex };
+        while (true) {
+            m_cv.wait(lock, [&]() { return m_stop || !m_pending.empty(); });
+            if (m_pending.empty()) return;
+
+            lock.unlock();
+            m_iteration_stream->write(reinterpret_cast<const char*>(m_pending.data()),
+                                      m_pending.size() * sizeof(metric_record));
+            lock.lock();
+
+            m_pending.clear();
+            m_cv.notify_all();
+        }
+    }
+
+}
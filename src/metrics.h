@@ -0,0 +1,98 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "netlist.h"
+
+namespace Utils {
+
+    // Layout of the binary iteration file: a metric_file_header followed by metric_records, both
+    // in host byte order, which byte_order records. src/metrics_reader.py decodes it.
+    struct metric_file_header {
+        char magic[4];
+        std::uint32_t version;
+        std::uint32_t record_size;
+        std::uint32_t byte_order;
+    };
+
+    struct metric_record {
+        std::uint64_t iteration;
+        std::int64_t bbox;
+        std::uint32_t accepted;
+        std::uint32_t reserved;
+    };
+
+    struct metric_options {
+        std::size_t decimation = 1;
+        bool change_only = false;
+        std::size_t buffer_records = 1 << 16;
+    };
+
+    // Iteration records are appended to a buffer on the calling thread. Full buffers are swapped
+    // with a second one that a background thread writes out, so the placer only blocks when the
+    // writer falls a whole buffer behind. Snapshots stay plain text.
+    class metric_consumer {
+
+    public:
+
+        static constexpr std::uint32_t version = 2;
+        static constexpr std::uint32_t byte_order = 0x01020304;
+
+        metric_consumer(const std::string &iter_filename, const std::string &snapshot_filename,
+            const metric_options &options = metric_options{});
+        ~metric_consumer();
+
+        metric_consumer &operator=(const metric_consumer&) = delete;
+        metric_consumer(const metric_consumer&) = delete;
+
+        inline void record(std::int64_t bbox, bool accepted) {
+            std::uint64_t iteration = m_iteration++;
+            if (iteration % m_options.decimation != 0) return;
+            if (m_options.change_only && bbox == m_last_bbox) return;
+
+            m_last_bbox = bbox;
+            m_active.push_back(metric_record{ iteration, bbox, accepted ? 1u : 0u, 0u });
+            if (m_active.size() >= m_options.buffer_records) hand_off();
+        }
+
+        inline std::ostream &snapshot() { return *m_snapshot_stream; }
+
+        void flush();
+
+        inline operator bool() {
+            flush();
+            std::lock_guard<std::mutex> lock{ m_mutex };
+            return bool(*m_iteration_stream) && bool(*m_snapshot_stream);
+        }
+
+    private:
+
+        void hand_off();
+        void writer_loop();
+
+        metric_options m_options;
+        std::uint64_t m_iteration;
+        std::int64_t m_last_bbox;
+
+        std::unique_ptr<std::ofstream> m_iteration_stream;
+        std::unique_ptr<std::ostream> m_snapshot_stream;
+
+        std::vector<metric_record> m_active;
+        std::vector<metric_record> m_pending;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        bool m_stop;
+        std::thread m_writer;
+
+    };
+
+}
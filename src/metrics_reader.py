@@ -0,0 +1,55 @@
+# (C) Copyright Shou Hao Ho   2018
+# Distributed under the MIT Software License (See accompanying LICENSE file)
+
+from __future__ import print_function
+import struct
+import sys
+
+MAGIC = b"PLMT"
+VERSION = 2
+BYTE_ORDER = 0x01020304
+
+def read_iterations(filepath):
+    """Returns (iterations, bboxes, accepted) from an iteration file written by metric_consumer.
+    Plain text files with one bbox per line are accepted too."""
+    try:
+        hfile = open(filepath, "rb")
+    except Exception as e:
+        sys.stderr.write("ERROR: " + filepath + " cannot be opened: " + str(e))
+        exit(1)
+
+    data = hfile.read()
+    hfile.close()
+
+    if data[:len(MAGIC)] != MAGIC:
+        bboxes = [int(line) for line in data.decode("ascii").split() if line.strip() != ""]
+        return list(range(len(bboxes))), bboxes, [None] * len(bboxes)
+
+    # The writer uses host byte order; the header's byte order mark tells which one that was
+    endian = None
+    for prefix in ("<", ">"):
+        _, version, record_size, byte_order = struct.unpack_from(prefix + "4sIII", data, 0)
+        if version == VERSION and byte_order == BYTE_ORDER:
+            endian = prefix
+            break
+
+    if endian is None:
+        sys.stderr.write("ERROR: " + filepath + " has an unsupported version or byte order\n")
+        exit(1)
+
+    header = struct.Struct(endian + "4sIII")
+    record = struct.Struct(endian + "QqII")
+    if record_size != record.size:
+        sys.stderr.write("ERROR: " + filepath + " has unsupported record size " + str(record_size) + "\n")
+        exit(1)
+
+    iterations = []
+    bboxes = []
+    accepted = []
+    for offset in range(header.size, len(data) - record.size + 1, record.size):
+        iteration, bbox, flag, _ = record.unpack_from(data, offset)
+        iterations.append(iteration)
+        bboxes.append(bbox)
+        accepted.append(flag != 0)
+
+    return iterations, bboxes, accepted
\ No newline at end of file
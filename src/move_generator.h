@@ -0,0 +1,76 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include "chip.h"
+
+// Move proposal and acceptance shared by the serial annealers and the parallel engines, so that
+// they all draw from their engines in the same order.
+
+namespace Utils {
+
+    namespace impl {
+
+        class move_generator {
+
+        public:
+
+            move_generator(const Chip &chip)
+                :m_chip{ chip },
+                m_netlist{ chip.get_netlist() },
+                m_chip_dist{ 0, chip.get_width() * chip.get_height() / 2 - 1 },
+                m_lut_dist{ 0, chip.get_netlist().num_luts() - 1 },
+                m_ff_dist{ 0, chip.get_netlist().num_ffs() - 1 }
+            {}
+
+            inline const Atom &atom(std::mt19937 &eng) {
+                return m_type_dist(eng) ? get<Netlist::LUT>(m_netlist, m_lut_dist(eng)) :
+                                          get<Netlist::FF>(m_netlist, m_ff_dist(eng));
+            }
+
+            inline std::size_t site(std::mt19937 &eng) { return m_chip_dist(eng); }
+
+            // Any site can be swapped into, so a uniform draw inside the window around the atom
+            // is already O(1) and needs no occupancy index.
+            inline std::size_t site_near(const Atom &atom, std::mt19937 &eng, std::int64_t rlim) {
+                Chip::coord center = m_chip.get_coord(atom);
+                std::int64_t max_x = static_cast<std::int64_t>(m_chip.get_height()) - 1;
+                std::int64_t max_y = static_cast<std::int64_t>(m_chip.get_width()) - 1;
+
+                std::uniform_int_distribution<std::int64_t> x_dist{ std::max<std::int64_t>(0, center.x - rlim),
+                                                                   std::min(max_x, center.x + rlim) };
+                std::uniform_int_distribution<std::int64_t> y_dist{ std::max<std::int64_t>(0, center.y - rlim),
+                                                                   std::min(max_y, center.y + rlim) };
+                std::size_t site = static_cast<std::size_t>(x_dist(eng)) * m_chip.get_width() + static_cast<std::size_t>(y_dist(eng));
+                return std::min(site / 2, m_chip_dist.max());
+            }
+
+        private:
+
+            const Chip &m_chip;
+            const Netlist &m_netlist;
+            std::bernoulli_distribution m_type_dist;
+            std::uniform_int_distribution<std::size_t> m_chip_dist;
+            std::uniform_int_distribution<std::size_t> m_lut_dist;
+            std::uniform_int_distribution<std::size_t> m_ff_dist;
+
+        };
+
+        // Metropolis criterion. The threshold is only drawn for uphill moves.
+        inline bool metropolis_accept(std::int64_t delta, double temperature, std::mt19937 &eng) {
+            std::uniform_real_distribution<double> unif{ 0.0, 1.0 };
+            return delta <= 0 || unif(eng) < std::exp(static_cast<double>(-delta) / temperature);
+        }
+
+        // Same criterion with a threshold drawn up front, for moves evaluated ahead of their commit.
+        inline bool metropolis_accept(std::int64_t delta, double temperature, double threshold) {
+            return delta <= 0 || threshold < std::exp(static_cast<double>(-delta) / temperature);
+        }
+
+    }
+
+}
\ No newline at end of file
@@ -4,8 +4,12 @@
 #pragma once
 
 #include <boost/range.hpp>
+#include <cstdint>
 #include <exception>
+#include <memory>
+#include <new>
 #include <vector>
+#include "arena.h"
 
 #define RUNTIME_ASSERT(COND) if (!(COND)) { throw std::runtime_error{ #COND }; }
 
@@ -58,58 +62,38 @@ class OPort {
 public:
 
     OPort(Atom &atom, std::size_t max_fanouts)
-        :m_fanouts{},
+        :m_fanouts{ nullptr },
+        m_size{ 0 },
+        m_capacity{ 0 },
         max_fanouts{ max_fanouts },
         m_atom{ &atom }
     {}
 
-    OPort(const OPort &other)
-        :m_fanouts{ other.m_fanouts },
-        max_fanouts{ other.max_fanouts },
-        m_atom{ other.m_atom }
-    {}
-
-    OPort(OPort &&other)
-        :m_fanouts{ std::move(other.m_fanouts) },
-        max_fanouts{ other.max_fanouts },
-        m_atom{ other.m_atom }
-    {}
-
-    OPort &operator=(const OPort &other) {
-        m_fanouts = other.m_fanouts;
-        max_fanouts = other.max_fanouts;
-        m_atom = other.m_atom;
-        return *this;
-    }
+    OPort(const OPort&) = delete;
+    OPort &operator=(const OPort&) = delete;
 
-    OPort &operator=(OPort &&other) {
-        m_fanouts = std::move(other.m_fanouts);
-        max_fanouts = other.max_fanouts;
-        m_atom = other.m_atom;
-        return *this;
-    }
-
-    inline auto begin() { return m_fanouts.begin(); }
-    inline auto begin() const { return m_fanouts.begin(); }
-    inline auto end() { return m_fanouts.end(); }
-    inline auto end() const { return m_fanouts.end(); }
+    inline IPort** begin() { return m_fanouts; }
+    inline IPort* const* begin() const { return m_fanouts; }
+    inline IPort** end() { return m_fanouts + m_size; }
+    inline IPort* const* end() const { return m_fanouts + m_size; }
 
-    inline bool empty() const { return m_fanouts.empty(); }
-    inline std::size_t size() const { return m_fanouts.size(); }
+    inline bool empty() const { return m_size == 0; }
+    inline std::size_t size() const { return m_size; }
     inline std::size_t capacity_left() const { return max_fanouts - size(); }
 
-    IPort &push_back(IPort &iport) {
-        RUNTIME_ASSERT(capacity_left() > 0);
-        m_fanouts.emplace_back(&iport);
-        return *m_fanouts.back();
-    }
+    inline void reserve(std::size_t num_fanouts);
+    inline IPort &push_back(IPort &iport);
 
     inline Atom &get_atom() { return *m_atom; }
     inline const Atom &get_atom() const { return *m_atom; }
 
 private:
 
-    std::vector<IPort*> m_fanouts;
+    inline void grow(std::size_t capacity);
+
+    IPort** m_fanouts;
+    std::uint32_t m_size;
+    std::uint32_t m_capacity;
     std::size_t max_fanouts;
     Atom* m_atom;
 
@@ -117,6 +101,8 @@ private:
 
 class Atom {
 
+    friend class OPort;
+
 public:
 
     enum class type {
@@ -126,61 +112,60 @@ public:
         OPIN
     };
 
-    Atom(std::size_t max_inputs, std::size_t max_outputs, std::size_t max_fanouts, type t)
-        :m_inputs( max_inputs, IPort{ *this } ),
-        m_outputs( max_outputs, OPort{ *this, max_fanouts } ),
+    Atom(Utils::arena &arena, std::size_t max_inputs, std::size_t max_outputs, std::size_t max_fanouts, type t)
+        :m_inputs{ arena.allocate<IPort>(max_inputs) },
+        m_outputs{ arena.allocate<OPort>(max_outputs) },
+        m_num_inputs{ static_cast<std::uint32_t>(max_inputs) },
+        m_num_outputs{ static_cast<std::uint32_t>(max_outputs) },
         m_type{ t },
-        m_phase{ std::numeric_limits<std::size_t>::max() }
-    {}
+        m_phase{ std::numeric_limits<std::size_t>::max() },
+        m_arena{ &arena }
+    {
+        std::for_each(m_inputs, m_inputs + m_num_inputs, [&](IPort &iport) { new (&iport) IPort{ *this }; });
+        std::for_each(m_outputs, m_outputs + m_num_outputs, [&](OPort &oport) { new (&oport) OPort{ *this, max_fanouts }; });
+    }
 
-    Atom(const Atom &other)
-        :m_inputs{ other.m_inputs },
-        m_outputs{ other.m_outputs },
-        m_type{ other.m_type },
-        m_phase{ other.m_phase }
-    {}
+    Atom(const Atom&) = delete;
+    Atom &operator=(const Atom&) = delete;
 
     Atom(Atom &&other)
-        :m_inputs{ std::move(other.m_inputs) },
-        m_outputs{ std::move(other.m_outputs) },
+        :m_inputs{ other.m_inputs },
+        m_outputs{ other.m_outputs },
+        m_num_inputs{ other.m_num_inputs },
+        m_num_outputs{ other.m_num_outputs },
         m_type{ other.m_type },
-        m_phase{ other.m_phase }
-    {}
-
-    Atom &operator=(const Atom &other) {
-        m_inputs = other.m_inputs;
-        m_outputs = other.m_outputs;
-        m_type = other.m_type;
-        m_phase = other.m_phase;
-        return *this;
+        m_phase{ other.m_phase },
+        m_arena{ other.m_arena }
+    {
+        init_back_pointer();
     }
 
     Atom &operator=(Atom &&other) {
-        m_inputs = std::move(other.m_inputs);
-        m_outputs = std::move(other.m_outputs);
+        m_inputs = other.m_inputs;
+        m_outputs = other.m_outputs;
+        m_num_inputs = other.m_num_inputs;
+        m_num_outputs = other.m_num_outputs;
         m_type = other.m_type;
         m_phase = other.m_phase;
+        m_arena = other.m_arena;
+        init_back_pointer();
         return *this;
     }
 
     void init_back_pointer() {
-        for (IPort &iport : m_inputs) {
-            iport.m_atom = this;
-        }
-        for (OPort &oport : m_outputs) {
-            oport.m_atom = this;
-        }
+        std::for_each(m_inputs, m_inputs + m_num_inputs, [&](IPort &iport) { iport.m_atom = this; });
+        std::for_each(m_outputs, m_outputs + m_num_outputs, [&](OPort &oport) { oport.m_atom = this; });
     }
 
-    inline auto begin_inputs() { return m_inputs.begin(); }
-    inline auto begin_inputs() const { return m_inputs.begin(); }
-    inline auto end_inputs() { return m_inputs.end(); }
-    inline auto end_inputs() const { return m_inputs.end(); }
+    inline IPort* begin_inputs() { return m_inputs; }
+    inline const IPort* begin_inputs() const { return m_inputs; }
+    inline IPort* end_inputs() { return m_inputs + m_num_inputs; }
+    inline const IPort* end_inputs() const { return m_inputs + m_num_inputs; }
 
-    inline auto begin_outputs() { return m_outputs.begin(); }
-    inline auto begin_outputs() const { return m_outputs.begin(); }
-    inline auto end_outputs() { return m_outputs.end(); }
-    inline auto end_outputs() const { return m_outputs.end(); }
+    inline OPort* begin_outputs() { return m_outputs; }
+    inline const OPort* begin_outputs() const { return m_outputs; }
+    inline OPort* end_outputs() { return m_outputs + m_num_outputs; }
+    inline const OPort* end_outputs() const { return m_outputs + m_num_outputs; }
 
     inline auto inputs() { return boost::make_iterator_range(begin_inputs(), end_inputs()); }
     inline auto inputs() const { return boost::make_iterator_range(begin_inputs(), end_inputs()); }
@@ -189,32 +174,32 @@ public:
     inline auto outputs() const { return boost::make_iterator_range(begin_outputs(), end_outputs()); }
 
     inline IPort &get_iport(std::size_t idx) {
-        RUNTIME_ASSERT(idx < m_inputs.size());
+        RUNTIME_ASSERT(idx < m_num_inputs);
         return m_inputs[idx];
     }
 
     const inline IPort &get_iport(std::size_t idx) const {
-        RUNTIME_ASSERT(idx < m_inputs.size());
+        RUNTIME_ASSERT(idx < m_num_inputs);
         return m_inputs[idx];
     }
 
     inline OPort &get_oport(std::size_t idx) {
-        RUNTIME_ASSERT(idx < m_outputs.size());
+        RUNTIME_ASSERT(idx < m_num_outputs);
         return m_outputs[idx];
     }
 
     const inline OPort &get_oport(std::size_t idx) const {
-        RUNTIME_ASSERT(idx < m_outputs.size());
+        RUNTIME_ASSERT(idx < m_num_outputs);
         return m_outputs[idx];
     }
 
     inline std::size_t num_unconnected_input() const {
-        return std::count_if(m_inputs.begin(), m_inputs.end(),
+        return std::count_if(begin_inputs(), end_inputs(),
                              [](const IPort &iport) { return !iport.has_fanin(); });
     }
 
     inline std::size_t num_unconnected_output() const {
-        return std::count_if(m_outputs.begin(), m_outputs.end(),
+        return std::count_if(begin_outputs(), end_outputs(),
             [](const OPort &oport) { return !oport.empty(); });
     }
 
@@ -228,34 +213,48 @@ public:
 
 protected:
 
-    std::vector<IPort> m_inputs;
-    std::vector<OPort> m_outputs;
+    IPort* m_inputs;
+    OPort* m_outputs;
+    std::uint32_t m_num_inputs;
+    std::uint32_t m_num_outputs;
     type m_type;
     std::size_t m_phase;
+    Utils::arena* m_arena;
 
 };
 
+inline void OPort::reserve(std::size_t num_fanouts) {
+    num_fanouts = std::min(num_fanouts, max_fanouts);
+    if (num_fanouts > m_capacity) grow(num_fanouts);
+}
+
+inline IPort &OPort::push_back(IPort &iport) {
+    RUNTIME_ASSERT(capacity_left() > 0);
+    if (m_size == m_capacity) grow(std::min<std::size_t>(max_fanouts, m_capacity == 0 ? 4 : m_capacity * 2));
+    m_fanouts[m_size++] = &iport;
+    return iport;
+}
+
+inline void OPort::grow(std::size_t capacity) {
+    IPort** fanouts = m_atom->m_arena->allocate<IPort*>(capacity);
+    std::copy(m_fanouts, m_fanouts + m_size, fanouts);
+    m_atom->m_arena->release(m_fanouts, m_capacity);
+    m_fanouts = fanouts;
+    m_capacity = static_cast<std::uint32_t>(capacity);
+}
+
 class IPin : public Atom {
 
 public:
 
-    IPin(std::size_t max_fanouts)
-        :Atom{ 0, 1, max_fanouts, Atom::type::IPIN }
-    {}
-
-    IPin(const IPin &other)
-        :Atom{ other }
+    IPin(Utils::arena &arena, std::size_t max_fanouts)
+        :Atom{ arena, 0, 1, max_fanouts, Atom::type::IPIN }
     {}
 
     IPin(IPin &&other)
         :Atom{ std::move(other) }
     {}
 
-    IPin &operator=(const IPin &other) {
-        Atom::operator=(other);
-        return *this;
-    }
-
     IPin &operator=(IPin &&other) {
         Atom::operator=(std::move(other));
         return *this;
@@ -275,23 +274,14 @@ class OPin : public Atom {
 
 public:
 
-    OPin()
-        :Atom{ 1, 0, 0, Atom::type::OPIN }
-    {}
-
-    OPin(const OPin &other)
-        :Atom{ other }
+    OPin(Utils::arena &arena)
+        :Atom{ arena, 1, 0, 0, Atom::type::OPIN }
     {}
 
     OPin(OPin &&other)
         :Atom{ std::move(other) }
     {}
 
-    OPin &operator=(const OPin &other) {
-        Atom::operator=(other);
-        return *this;
-    }
-
     OPin &operator=(OPin &&other) {
         Atom::operator=(std::move(other));
         return *this;
@@ -315,16 +305,25 @@ public:
 
     Netlist(std::size_t num_ipins, std::size_t num_opins, std::size_t num_luts, std::size_t num_ffs,
             std::size_t max_inputs, std::size_t max_outputs, std::size_t max_fanouts)
-        :m_luts( num_luts, Atom{ max_inputs, max_outputs, max_fanouts, Atom::type::LUT } ),
-        m_ffs( num_ffs, Atom{ max_inputs, max_outputs, max_fanouts, Atom::type::FF } ),
-        m_ipins( num_ipins, IPin{ max_fanouts } ),
-        m_opins( num_opins )
+        :m_arena{ std::make_unique<Utils::arena>() }
     {
-        init_back_pointers();
+        std::size_t num_cells = num_luts + num_ffs;
+        m_arena->reserve((num_cells * max_inputs + num_opins) * sizeof(IPort) +
+                         (num_cells * max_outputs + num_ipins) * sizeof(OPort) + 4 * alignof(OPort));
+
+        m_luts.reserve(num_luts);
+        m_ffs.reserve(num_ffs);
+        m_ipins.reserve(num_ipins);
+        m_opins.reserve(num_opins);
+        for (std::size_t i = 0; i < num_luts; ++i) m_luts.emplace_back(*m_arena, max_inputs, max_outputs, max_fanouts, Atom::type::LUT);
+        for (std::size_t i = 0; i < num_ffs; ++i) m_ffs.emplace_back(*m_arena, max_inputs, max_outputs, max_fanouts, Atom::type::FF);
+        for (std::size_t i = 0; i < num_ipins; ++i) m_ipins.emplace_back(*m_arena, max_fanouts);
+        for (std::size_t i = 0; i < num_opins; ++i) m_opins.emplace_back(*m_arena);
     }
 
     Netlist(Netlist &&other)
-        :m_luts{ std::move(other.m_luts) },
+        :m_arena{ std::move(other.m_arena) },
+        m_luts{ std::move(other.m_luts) },
         m_ffs{ std::move(other.m_ffs) },
         m_ipins{ std::move(other.m_ipins) },
         m_opins{ std::move(other.m_opins) }
@@ -335,6 +334,7 @@ public:
         m_ffs = std::move(other.m_ffs);
         m_ipins = std::move(other.m_ipins);
         m_opins = std::move(other.m_opins);
+        m_arena = std::move(other.m_arena);
         return *this;
     }
 
@@ -377,14 +377,9 @@ public:
 
 private:
 
-    void init_back_pointers() {
-        auto init = [](Atom &atom) { atom.init_back_pointer(); };
-        std::for_each(m_luts.begin(), m_luts.end(), init);
-        std::for_each(m_ffs.begin(), m_ffs.end(), init);
-        std::for_each(m_ipins.begin(), m_ipins.end(), init);
-        std::for_each(m_opins.begin(), m_opins.end(), init);
-    }
-
+    // Ports and fanout lists of every atom are carved from the arena, so they are freed together
+    // with it. It is declared first so that it outlives the atoms pointing into it.
+    std::unique_ptr<Utils::arena> m_arena;
     std::vector<Atom> m_luts;
     std::vector<Atom> m_ffs;
     std::vector<IPin> m_ipins;
@@ -467,6 +462,16 @@ namespace Utils {
     Netlist random_netlist(std::size_t num_ipins, std::size_t num_opins, std::size_t num_luts,
         std::size_t num_ffs, std::size_t num_inputs, std::size_t num_outputs, std::size_t num_phases = 1);
 
-    void dump_netlist(const Netlist &netlist, const std::string &filepath);
+    // Same shape of netlist as random_netlist, generated in fixed-size chunks on num_threads threads.
+    // Every chunk draws from its own stream, so the result depends on the seed but not on num_threads.
+    Netlist parallel_random_netlist(std::size_t num_ipins, std::size_t num_opins, std::size_t num_luts, std::size_t num_ffs,
+        std::size_t num_inputs, std::size_t num_outputs, std::size_t num_phases, std::size_t num_threads, std::uint64_t seed = 0);
+
+    enum class netlist_ids {
+        pointer,
+        integer
+    };
+
+    void dump_netlist(const Netlist &netlist, const std::string &filepath, netlist_ids ids = netlist_ids::pointer);
 
 };
\ No newline at end of file
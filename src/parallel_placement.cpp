@@ -0,0 +1,313 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+
+#include "placement.h"
+#include "move_generator.h"
+#include "perf_counters.h"
+#include "stats.h"
+#include "trace.h"
+
+namespace Utils {
+
+    namespace impl {
+
+        constexpr std::size_t moves_per_region_batch = 256;
+
+        std::mt19937 stream_engine(std::uint64_t seed, std::uint64_t step, std::uint64_t stream) {
+            std::seed_seq seq{ static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32),
+                               static_cast<std::uint32_t>(step), static_cast<std::uint32_t>(step >> 32),
+                               static_cast<std::uint32_t>(stream) };
+            return std::mt19937{ seq };
+        }
+
+        // Horizontal bands of rows, one per worker. The bands wrap around the chip and are shifted
+        // by half a band every temperature step so that atoms can drift across band boundaries.
+        class row_regions {
+
+        public:
+
+            row_regions(std::size_t height, std::size_t num_regions, std::size_t step)
+                :m_region_of(height),
+                m_rows(num_regions)
+            {
+                std::size_t offset = (step * (height / num_regions / 2 + 1)) % height;
+                for (std::size_t r = 0; r < num_regions; ++r) {
+                    for (std::size_t k = r * height / num_regions; k < (r + 1) * height / num_regions; ++k) {
+                        std::size_t row = (k + offset) % height;
+                        m_region_of[row] = r;
+                        m_rows[r].push_back(static_cast<std::int64_t>(row));
+                    }
+                }
+            }
+
+            inline std::size_t size() const { return m_rows.size(); }
+            inline std::size_t region_of(std::int64_t row) const { return m_region_of[row]; }
+            inline const std::vector<std::int64_t> &rows(std::size_t region) const { return m_rows[region]; }
+
+        private:
+
+            std::vector<std::size_t> m_region_of;
+            std::vector<std::vector<std::int64_t>> m_rows;
+
+        };
+
+        struct region_move {
+            const Atom* atom;
+            std::size_t idx;
+            double threshold;
+            bool accepted;
+            Chip::pending_swap pending;
+        };
+
+        void anneal_moves(Chip &chip, std::mt19937 &eng, std::size_t num_moves, double temperature) {
+            move_generator moves{ chip };
+            Chip::pending_swap pending;
+
+            for (std::size_t j = 0; j < num_moves; ++j) {
+                const Atom &atom_to_swap = moves.atom(eng);
+                std::size_t new_idx = moves.site(eng);
+                std::int64_t delta = chip.evaluate_swap(atom_to_swap, new_idx, pending);
+
+                if (metropolis_accept(delta, temperature, eng)) {
+                    chip.commit(pending);
+                    PLACER_STATS_ADD(sa_accepted, 1);
+                }
+            }
+            PLACER_STATS_ADD(sa_moves, num_moves);
+        }
+
+    }
+
+    void parallel_simulated_annealing(Chip &chip, std::int64_t num_iter, std::size_t num_swap_per_temperature, double hot,
+        double cooling_factor, std::size_t num_threads, std::uint64_t seed, metric_consumer* met)
+    {
+        PLACER_STATS_REPORT_SCOPE(parallel_simulated_annealing);
+        PLACER_TRACE_SPAN("parallel_simulated_annealing");
+        thread_pool pool{ num_threads };
+        std::size_t num_regions = std::max<std::size_t>(1, std::min(pool.size(), chip.get_height()));
+        std::size_t num_sites = chip.get_width() * chip.get_height();
+
+        if (met != nullptr) {
+            met->snapshot() << "ss " << 0 << " (" << chip.get_width() << "," << chip.get_height() << "):\n";
+            dump_chip(chip, met->snapshot());
+        }
+
+        std::vector<std::vector<const Atom*>> region_atoms(num_regions);
+        std::vector<std::vector<impl::region_move>> proposals(num_regions);
+
+        // Nets and sites touched by a commit of the current batch carry the batch's stamp
+        const FlatNetlist &flat = chip.get_flat_netlist();
+        std::vector<std::uint64_t> net_stamps(flat.num_nets(), 0);
+        std::vector<std::uint64_t> site_stamps(num_sites, 0);
+        std::uint64_t stamp = 0;
+
+        auto nets_touched = [&](FlatNetlist::id_type id) {
+            if (id == FlatNetlist::invalid_id) return false;
+            auto touched = [&](FlatNetlist::id_type net) { return net_stamps[net] == stamp; };
+            return std::any_of(flat.driven_nets(id).begin(), flat.driven_nets(id).end(), touched) ||
+                   std::any_of(flat.fanin_nets(id).begin(), flat.fanin_nets(id).end(), touched);
+        };
+        auto touch_nets = [&](FlatNetlist::id_type id) {
+            if (id == FlatNetlist::invalid_id) return;
+            for (FlatNetlist::id_type net : flat.driven_nets(id)) net_stamps[net] = stamp;
+            for (FlatNetlist::id_type net : flat.fanin_nets(id)) net_stamps[net] = stamp;
+        };
+
+        double temperature = hot;
+        for (std::int64_t i = 0; i < num_iter; ++i) {
+            PLACER_TRACE_SPAN_ARG("sa_temperature", "temperature", temperature);
+            PLACER_STATS_TIMER(sa_temperature);
+            impl::row_regions regions{ chip.get_height(), num_regions, static_cast<std::size_t>(i) };
+
+            for (auto &atoms : region_atoms) atoms.clear();
+            auto assign_region = [&](const Atom &atom) {
+                region_atoms[regions.region_of(chip.get_coord(atom).x)].push_back(&atom);
+            };
+            std::for_each(chip.get_netlist().begin_luts(), chip.get_netlist().end_luts(), assign_region);
+            std::for_each(chip.get_netlist().begin_ffs(), chip.get_netlist().end_ffs(), assign_region);
+
+            std::vector<std::mt19937> engines;
+            for (std::size_t r = 0; r < num_regions; ++r) {
+                engines.push_back(impl::stream_engine(seed, static_cast<std::uint64_t>(i), r));
+            }
+
+            // Regions without atoms get no moves, the others split each batch evenly
+            std::vector<std::size_t> region_rank(num_regions);
+            std::size_t num_active = 0;
+            for (std::size_t r = 0; r < num_regions; ++r) {
+                region_rank[r] = num_active;
+                if (!region_atoms[r].empty()) ++num_active;
+            }
+            if (num_active == 0) break;
+
+            std::size_t per_region = std::min(impl::moves_per_region_batch,
+                                               (num_swap_per_temperature + num_active - 1) / num_active);
+            for (std::size_t done = 0; done < num_swap_per_temperature;) {
+                PLACER_STATS_TIMER(psa_batch);
+                std::size_t batch = std::min(per_region * num_active, num_swap_per_temperature - done);
+                done += batch;
+                ++stamp;
+
+                // Proposals are evaluated concurrently against the same board, then committed in a fixed
+                // region order. A move whose sites or nets were touched by an earlier commit is re-evaluated
+                // with its pre-drawn threshold, which keeps the result independent of thread timing.
+                pool.parallel_for(0, num_regions, [&](std::size_t r) {
+                    PLACER_TRACE_SPAN_ARG("psa_propose", "region", r);
+                    PLACER_PERF_STAGE(swap_evaluation);
+                    std::mt19937 &eng = engines[r];
+                    std::vector<impl::region_move> &out = proposals[r];
+                    const std::vector<const Atom*> &atoms = region_atoms[r];
+                    const std::vector<std::int64_t> &rows = regions.rows(r);
+
+                    out.clear();
+                    if (atoms.empty()) return;
+
+                    std::uniform_int_distribution<std::size_t> atom_dist{ 0, atoms.size() - 1 };
+                    std::uniform_int_distribution<std::size_t> row_dist{ 0, rows.size() - 1 };
+                    std::uniform_int_distribution<std::size_t> col_dist{ 0, chip.get_width() - 1 };
+                    std::uniform_real_distribution<double> unif{ 0.0, 1.0 };
+
+                    std::size_t num_moves = batch / num_active + (region_rank[r] < batch % num_active ? 1 : 0);
+                    out.resize(num_moves);
+                    for (std::size_t k = 0; k < num_moves; ++k) {
+                        impl::region_move &move = out[k];
+                        const Atom* atom = atoms[atom_dist(eng)];
+                        std::size_t site = rows[row_dist(eng)] * chip.get_width() + col_dist(eng);
+                        double threshold = unif(eng);
+
+                        std::size_t idx = site / 2;
+                        std::size_t typed_site = atom->get_type() == Atom::type::LUT ? idx * 2 : idx * 2 + 1;
+                        move.atom = atom;
+                        move.idx = idx;
+                        move.threshold = threshold;
+                        move.accepted = false;
+                        if (typed_site >= num_sites || regions.region_of(typed_site / chip.get_width()) != r) continue;
+
+                        std::int64_t delta = chip.evaluate_swap(*atom, idx, move.pending);
+                        move.accepted = impl::metropolis_accept(delta, temperature, threshold);
+                    }
+                    PLACER_STATS_ADD(sa_moves, num_moves);
+                });
+
+                PLACER_TRACE_SPAN("psa_commit");
+                PLACER_PERF_STAGE(swap_commit);
+                for (auto &moves : proposals) {
+                    for (impl::region_move &move : moves) {
+                        std::int64_t prev_bbox = chip.get_bbox();
+                        bool accepted = move.accepted;
+
+                        // An untouched proposal still describes the board, so it commits as evaluated
+                        Chip::pending_swap &pending = move.pending;
+                        if (accepted && (site_stamps[pending.lhs_site] == stamp || site_stamps[pending.rhs_site] == stamp ||
+                                         nets_touched(pending.lhs_id) || nets_touched(pending.rhs_id))) {
+                            std::int64_t delta = chip.evaluate_swap(*move.atom, move.idx, pending);
+                            accepted = impl::metropolis_accept(delta, temperature, move.threshold);
+                        }
+
+                        if (accepted) {
+                            chip.commit(pending);
+                            site_stamps[pending.lhs_site] = stamp;
+                            site_stamps[pending.rhs_site] = stamp;
+                            touch_nets(pending.lhs_id);
+                            touch_nets(pending.rhs_id);
+                            PLACER_STATS_ADD(sa_accepted, 1);
+                        }
+
+                        if (met != nullptr) {
+                            met->record(prev_bbox, accepted);
+                        }
+                    }
+                }
+            }
+
+            PLACER_STATS_ADD(sa_temperatures, 1);
+            temperature *= cooling_factor;
+        }
+
+        if (met != nullptr) {
+            met->snapshot() << "ss " << 0 << " (" << chip.get_width() << "," << chip.get_height() << "):\n";
+            dump_chip(chip, met->snapshot());
+        }
+    }
+
+    Chip parallel_tempering(const Chip &chip, std::int64_t num_exchanges, std::size_t num_swap_per_exchange, double cold,
+        double hot, std::size_t num_replicas, std::size_t num_threads, std::uint64_t seed, metric_consumer* met)
+    {
+        RUNTIME_ASSERT(num_replicas > 0 && cold > 0 && hot >= cold);
+        PLACER_STATS_REPORT_SCOPE(parallel_tempering);
+        PLACER_TRACE_SPAN("parallel_tempering");
+
+        thread_pool pool{ num_threads };
+
+        std::vector<Chip> replicas;
+        std::vector<std::mt19937> engines;
+        std::vector<double> temperatures;
+        replicas.reserve(num_replicas);
+        for (std::size_t k = 0; k < num_replicas; ++k) {
+            replicas.emplace_back(chip.clone());
+            engines.push_back(impl::stream_engine(seed, 0, k));
+            double ratio = num_replicas == 1 ? 0.0 : static_cast<double>(k) / (num_replicas - 1);
+            temperatures.push_back(cold * std::pow(hot / cold, ratio));
+        }
+
+        // replica_at[k] is the replica currently running at temperatures[k]. Exchanges permute this
+        // mapping instead of moving boards around.
+        std::vector<std::size_t> replica_at(num_replicas);
+        std::iota(replica_at.begin(), replica_at.end(), 0);
+
+        std::mt19937 exchange_eng{ impl::stream_engine(seed, 0, num_replicas) };
+        std::uniform_real_distribution<double> unif{ 0.0, 1.0 };
+
+        std::unique_ptr<Chip> best = std::make_unique<Chip>(chip.clone());
+
+        if (met != nullptr) {
+            met->snapshot() << "ss " << 0 << " (" << chip.get_width() << "," << chip.get_height() << "):\n";
+            dump_chip(chip, met->snapshot());
+        }
+
+        for (std::int64_t i = 0; i < num_exchanges; ++i) {
+            PLACER_TRACE_SPAN_ARG("pt_exchange", "exchange", i);
+            pool.parallel_for(0, num_replicas, [&](std::size_t k) {
+                PLACER_TRACE_SPAN_ARG("sa_temperature", "temperature", temperatures[k]);
+                PLACER_PERF_STAGE(sa_temperature);
+                std::size_t r = replica_at[k];
+                impl::anneal_moves(replicas[r], engines[r], num_swap_per_exchange, temperatures[k]);
+            });
+
+            for (std::size_t k = static_cast<std::size_t>(i % 2); k + 1 < num_replicas; k += 2) {
+                std::size_t lhs = replica_at[k];
+                std::size_t rhs = replica_at[k + 1];
+                double exponent = static_cast<double>(replicas[lhs].get_bbox() - replicas[rhs].get_bbox()) *
+                                  (1.0 / temperatures[k] - 1.0 / temperatures[k + 1]);
+                if (unif(exchange_eng) < std::exp(exponent)) {
+                    std::swap(replica_at[k], replica_at[k + 1]);
+                }
+            }
+
+            auto lowest = std::min_element(replicas.begin(), replicas.end(), [](const Chip &lhs, const Chip &rhs) {
+                return lhs.get_bbox() < rhs.get_bbox();
+            });
+            bool improved = lowest->get_bbox() < best->get_bbox();
+            if (improved) {
+                best = std::make_unique<Chip>(lowest->clone());
+            }
+
+            if (met != nullptr) {
+                met->record(best->get_bbox(), improved);
+            }
+        }
+
+        if (met != nullptr) {
+            met->snapshot() << "ss " << 0 << " (" << best->get_width() << "," << best->get_height() << "):\n";
+            dump_chip(*best, met->snapshot());
+        }
+
+        return std::move(*best);
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,193 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#include "perf_counters.h"
+
+#ifdef PLACER_ENABLE_PERF_COUNTERS
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstring>
+
+namespace Utils {
+
+    namespace perf {
+
+        namespace {
+
+#define PLACER_PERF_NAME(NAME) #NAME,
+            const char* const event_names[] = { PLACER_PERF_EVENTS(PLACER_PERF_NAME) };
+            const char* const stage_names[] = { PLACER_PERF_STAGES(PLACER_PERF_NAME) };
+#undef PLACER_PERF_NAME
+
+            struct event_config {
+                std::uint32_t type;
+                std::uint64_t config;
+            };
+
+            const event_config event_configs[] = {
+                { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+                { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+                { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+                { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+                { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES }
+            };
+
+            int open_event(const event_config &config, int group_fd) {
+                perf_event_attr attr;
+                std::memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = config.type;
+                attr.config = config.config;
+                attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0));
+            }
+
+            // The task clock leads the group since it opens wherever perf_event_open is allowed at
+            // all; the hardware events join it when the machine has a PMU that exposes them.
+            struct counter_group {
+                std::array<int, num_events> fds;
+                std::array<std::size_t, num_events> slots;
+                std::size_t num_open = 0;
+                std::uint32_t supported = 0;
+
+                counter_group() {
+                    fds.fill(-1);
+                    for (std::size_t e = 0; e < num_events; ++e) {
+                        if (e > 0 && fds[0] < 0) break;
+                        fds[e] = open_event(event_configs[e], e == 0 ? -1 : fds[0]);
+                        if (fds[e] < 0) continue;
+                        slots[num_open++] = e;
+                        supported |= 1u << e;
+                    }
+                }
+
+                ~counter_group() {
+                    for (int fd : fds) {
+                        if (fd >= 0) close(fd);
+                    }
+                }
+
+                counter_group(const counter_group&) = delete;
+                counter_group &operator=(const counter_group&) = delete;
+            };
+
+            struct stage_slot {
+                std::atomic<std::uint64_t> calls{ 0 };
+                std::atomic<std::uint32_t> supported{ 0 };
+                std::array<std::atomic<std::uint64_t>, num_events> values{};
+            };
+
+            std::array<stage_slot, num_stages> &get_stages() {
+                static std::array<stage_slot, num_stages> instance;
+                return instance;
+            }
+
+        }
+
+        sample read() {
+            thread_local counter_group group;
+
+            sample s;
+            if (group.num_open == 0) return s;
+
+            // nr, time_enabled, time_running, then one value per open event
+            std::array<std::uint64_t, 3 + num_events> buffer;
+            ssize_t expected = static_cast<ssize_t>((3 + group.num_open) * sizeof(std::uint64_t));
+            if (::read(group.fds[0], buffer.data(), expected) != expected) return s;
+
+            std::uint64_t enabled = buffer[1];
+            std::uint64_t running = buffer[2];
+            if (running == 0) return s;
+
+            // Scales for the time the group was multiplexed off the PMU
+            for (std::size_t i = 0; i < group.num_open; ++i) {
+                s.values[group.slots[i]] = running < enabled ?
+                    static_cast<std::uint64_t>(static_cast<double>(buffer[3 + i]) * enabled / running) : buffer[3 + i];
+            }
+            s.supported = group.supported;
+            return s;
+        }
+
+        const char* event_name(event e) {
+            return event_names[static_cast<std::size_t>(e)];
+        }
+
+        sample difference(const sample &end, const sample &begin) {
+            sample delta;
+            delta.supported = end.supported & begin.supported;
+            for (std::size_t e = 0; e < num_events; ++e) {
+                if ((delta.supported >> e & 1) == 0 || end.values[e] < begin.values[e]) continue;
+                delta.values[e] = end.values[e] - begin.values[e];
+            }
+            return delta;
+        }
+
+        void record(stage s, const sample &delta) {
+            stage_slot &slot = get_stages()[static_cast<std::size_t>(s)];
+            slot.calls.fetch_add(1, std::memory_order_relaxed);
+            slot.supported.fetch_or(delta.supported, std::memory_order_relaxed);
+            for (std::size_t e = 0; e < num_events; ++e) {
+                slot.values[e].fetch_add(delta.values[e], std::memory_order_relaxed);
+            }
+        }
+
+        stage_report collect() {
+            stage_report stages;
+            for (std::size_t s = 0; s < num_stages; ++s) {
+                stage_slot &slot = get_stages()[s];
+                stages[s].calls = slot.calls.exchange(0, std::memory_order_relaxed);
+                stages[s].counts.supported = slot.supported.exchange(0, std::memory_order_relaxed);
+                for (std::size_t e = 0; e < num_events; ++e) {
+                    stages[s].counts.values[e] = slot.values[e].exchange(0, std::memory_order_relaxed);
+                }
+            }
+            return stages;
+        }
+
+        void accumulate(stage_report &into, const stage_report &from) {
+            for (std::size_t s = 0; s < num_stages; ++s) {
+                into[s].calls += from[s].calls;
+                into[s].counts.supported |= from[s].counts.supported;
+                for (std::size_t e = 0; e < num_events; ++e) {
+                    into[s].counts.values[e] += from[s].counts.values[e];
+                }
+            }
+        }
+
+        void report(std::ostream &os, const std::string &title, const stage_report &stages) {
+            os << "perf: " << title << "\n";
+            for (std::size_t s = 0; s < num_stages; ++s) {
+                const stage_totals &totals = stages[s];
+                if (totals.calls == 0) continue;
+
+                os << "  " << stage_names[s] << ": calls = " << totals.calls;
+                for (std::size_t e = 0; e < num_events; ++e) {
+                    os << ", " << event_names[e] << " = ";
+                    if (totals.counts.supported >> e & 1) os << totals.counts.values[e];
+                    else os << "n/a";
+                }
+
+                std::uint64_t cycles = totals.counts.values[static_cast<std::size_t>(event::cycles)];
+                std::uint64_t instructions = totals.counts.values[static_cast<std::size_t>(event::instructions)];
+                if (is_supported(totals.counts, event::cycles) && is_supported(totals.counts, event::instructions) && cycles > 0) {
+                    os << ", ipc = " << static_cast<double>(instructions) / cycles;
+                }
+                os << "\n";
+            }
+        }
+
+        void report(std::ostream &os, const std::string &title) {
+            report(os, title, collect());
+        }
+
+    }
+
+}
+
+#endif
\ No newline at end of file
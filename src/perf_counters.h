@@ -0,0 +1,124 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#pragma once
+
+// Hardware performance counters of the placer stages, read through Linux perf_event_open. Every
+// thread counts its own user-space events, so stages run on pool workers are attributed to the
+// stage rather than to the thread that waits on them. Single swaps are not a stage: reading the
+// counters is a system call, an order of magnitude slower than the swap it would measure. The
+// incremental bbox is staged per batch of the parallel annealer instead, and placer_bench's
+// chip_evaluate_swap and chip_swap give its per-swap counts. Everything below, including the call
+// sites, compiles to nothing unless PLACER_ENABLE_PERF_COUNTERS is defined.
+
+#define PLACER_PERF_CONCAT_IMPL(A, B) A##B
+#define PLACER_PERF_CONCAT(A, B) PLACER_PERF_CONCAT_IMPL(A, B)
+
+#ifdef PLACER_ENABLE_PERF_COUNTERS
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#define PLACER_PERF_EVENTS(X)    \
+    X(task_clock_ns)             \
+    X(cycles)                    \
+    X(instructions)              \
+    X(llc_misses)                \
+    X(branch_misses)
+
+#define PLACER_PERF_STAGES(X)    \
+    X(random_placement)          \
+    X(sa_temperature)            \
+    X(swap_evaluation)           \
+    X(swap_commit)               \
+    X(initial_bbox)              \
+    X(qp_partition)              \
+    X(qp_assemble)               \
+    X(qp_solve)                  \
+    X(legalization)
+
+namespace Utils {
+
+    namespace perf {
+
+#define PLACER_PERF_ENUM(NAME) NAME,
+        enum class event { PLACER_PERF_EVENTS(PLACER_PERF_ENUM) num_events };
+        enum class stage { PLACER_PERF_STAGES(PLACER_PERF_ENUM) num_stages };
+#undef PLACER_PERF_ENUM
+
+        constexpr std::size_t num_events = static_cast<std::size_t>(event::num_events);
+        constexpr std::size_t num_stages = static_cast<std::size_t>(stage::num_stages);
+
+        // Counts of the calling thread since its counters were opened. An event the kernel or the
+        // hardware does not support stays at zero and is left out of the supported mask.
+        struct sample {
+            std::array<std::uint64_t, num_events> values{};
+            std::uint32_t supported = 0;
+        };
+
+        sample read();
+
+        const char* event_name(event e);
+
+        inline bool is_supported(const sample &s, event e) {
+            return (s.supported >> static_cast<std::size_t>(e) & 1) != 0;
+        }
+
+        sample difference(const sample &end, const sample &begin);
+
+        void record(stage s, const sample &delta);
+
+        class scoped_stage {
+
+        public:
+
+            explicit scoped_stage(stage s)
+                :m_stage{ s },
+                m_begin{ read() }
+            {}
+
+            ~scoped_stage() {
+                record(m_stage, difference(read(), m_begin));
+            }
+
+            scoped_stage(const scoped_stage&) = delete;
+            scoped_stage &operator=(const scoped_stage&) = delete;
+
+        private:
+
+            stage m_stage;
+            sample m_begin;
+
+        };
+
+        struct stage_totals {
+            std::uint64_t calls = 0;
+            sample counts;
+        };
+
+        using stage_report = std::array<stage_totals, num_stages>;
+
+        // Sums the stages of every thread and clears them.
+        stage_report collect();
+
+        void accumulate(stage_report &into, const stage_report &from);
+
+        void report(std::ostream &os, const std::string &title, const stage_report &stages);
+
+        // Writes everything collected since the last report.
+        void report(std::ostream &os, const std::string &title);
+
+    }
+
+}
+
+#define PLACER_PERF_STAGE(NAME) \
+    ::Utils::perf::scoped_stage PLACER_PERF_CONCAT(placer_perf_stage_, __LINE__){ ::Utils::perf::stage::NAME }
+
+#else
+
+#define PLACER_PERF_STAGE(NAME) ((void)0)
+
+#endif
\ No newline at end of file
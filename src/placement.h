@@ -3,47 +3,73 @@
 
 #pragma once
 
-#include <fstream>
+#include "checkpoint.h"
 #include "chip.h"
+#include "metrics.h"
 
 namespace Utils {
 
-    class metric_consumer {
-
-    public:
-
-        metric_consumer(const std::string &iter_filename, const std::string &snapshot_filename)
-            :m_iteration_stream{ std::make_unique<std::ofstream>(iter_filename, std::ios::out | std::ios::binary) },
-            m_snapshot_stream{ std::make_unique<std::ofstream>(snapshot_filename, std::ios::out | std::ios::binary) }
-        {
-            RUNTIME_ASSERT(m_iteration_stream && *m_iteration_stream);
-            RUNTIME_ASSERT(m_snapshot_stream && *m_snapshot_stream);
-        }
-
-        metric_consumer &operator=(const metric_consumer&) = delete;
-        metric_consumer(const metric_consumer&) = delete;
-
-        inline std::ostream &iter() { return *m_iteration_stream; }
-        inline std::ostream &snapshot() { return *m_snapshot_stream; }
-
-        inline operator bool() const {
-            m_iteration_stream->flush();
-            m_snapshot_stream->flush();
-            return bool(*m_iteration_stream) && bool(*m_snapshot_stream);
-        }
-
-    private:
+    enum class qp_solver {
+        direct,
+        conjugate_gradient_jacobi,
+        conjugate_gradient_ichol
+    };
 
-        std::unique_ptr<std::ostream> m_iteration_stream;
-        std::unique_ptr<std::ostream> m_snapshot_stream;
+    struct qp_options {
+        qp_solver solver = qp_solver::direct;
+        double tolerance = 1e-6;
+        int max_iterations = 0;
+        std::size_t num_threads = 1;
+    };
 
+    // VPR-style adaptive schedule. The start temperature is a multiple of the standard deviation of
+    // the swap deltas of the current placement, each temperature runs moves_per_atom * N^(4/3) moves,
+    // the cooling factor follows the acceptance rate, and annealing stops once the temperature is
+    // small relative to the average net cost or the bbox stops changing. With range_limited, target
+    // sites are drawn from a window around the atom that shrinks or grows to keep about 44% of the
+    // moves accepted. The window needs the acceptance rate this schedule tracks, so the
+    // fixed-schedule annealer and random placement draw target sites from the whole chip.
+    struct anneal_schedule {
+        double initial_temperature_factor = 20.0;
+        double moves_per_atom = 1.0;
+        double exit_temperature_factor = 0.005;
+        double improvement_tolerance = 1e-3;
+        std::size_t max_stalled_temperatures = 5;
+        bool range_limited = true;
     };
 
     void random_placement(Chip &chip, std::int64_t num_iter, metric_consumer* met = nullptr);
     void simulated_annealing(Chip &chip, std::int64_t num_iter, std::size_t num_swap_per_temperature, double hot, double cooling_factor, metric_consumer* met = nullptr);
+    void simulated_annealing(Chip &chip, const anneal_schedule &schedule, std::uint64_t seed = 0, metric_consumer* met = nullptr);
+
+    // The same placers, saving a checkpoint to checkpoint.filepath every checkpoint.interval and
+    // once more when they finish. The resume_ variants restore chip from that file and continue
+    // bit-exactly where it was taken, with the same arguments as the interrupted run, and keep
+    // checkpointing to it.
+    void random_placement(Chip &chip, std::int64_t num_iter, const checkpoint_options &checkpoint, metric_consumer* met = nullptr);
+    void resume_random_placement(Chip &chip, std::int64_t num_iter, const checkpoint_options &checkpoint, metric_consumer* met = nullptr);
+    void simulated_annealing(Chip &chip, std::int64_t num_iter, std::size_t num_swap_per_temperature, double hot, double cooling_factor,
+        const checkpoint_options &checkpoint, metric_consumer* met = nullptr);
+    void resume_simulated_annealing(Chip &chip, std::int64_t num_iter, std::size_t num_swap_per_temperature, double cooling_factor,
+        const checkpoint_options &checkpoint, metric_consumer* met = nullptr);
+    void simulated_annealing(Chip &chip, const anneal_schedule &schedule, std::uint64_t seed, const checkpoint_options &checkpoint,
+        metric_consumer* met = nullptr);
+    void resume_simulated_annealing(Chip &chip, const anneal_schedule &schedule, const checkpoint_options &checkpoint,
+        metric_consumer* met = nullptr);
+    void parallel_simulated_annealing(Chip &chip, std::int64_t num_iter, std::size_t num_swap_per_temperature, double hot,
+        double cooling_factor, std::size_t num_threads, std::uint64_t seed = 0, metric_consumer* met = nullptr);
+    Chip parallel_tempering(const Chip &chip, std::int64_t num_exchanges, std::size_t num_swap_per_exchange, double cold,
+        double hot, std::size_t num_replicas, std::size_t num_threads, std::uint64_t seed = 0, metric_consumer* met = nullptr);
+
+    void dump_chip(const Chip &chip, std::ostream &os);
 
     void dump_plan(const Plan &plan, std::ostream &os);
     Plan quadratic_placement(std::size_t width, std::size_t height, const Netlist &netlist, int num_iter,
-        Plan::partitioning_method method, std::size_t expected_phases, metric_consumer* met = nullptr);
+        Plan::partitioning_method method, std::size_t expected_phases, metric_consumer* met = nullptr,
+        const qp_options &options = qp_options{});
+
+    // Assembles the system of every partition of plan as quadratic_placement's next solve would,
+    // without solving it, and returns their total number of nonzeros. placer_bench times it alone.
+    std::size_t assemble_qp_systems(const Plan &plan, std::size_t expected_phases);
 
 }
\ No newline at end of file
@@ -0,0 +1,335 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "chip.h"
+#include "perf_counters.h"
+#include "placement.h"
+#include "stats.h"
+
+namespace {
+
+    std::atomic<std::size_t> num_allocations{ 0 };
+
+}
+
+void* operator new(std::size_t size) {
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size == 0 ? 1 : size)) return ptr;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+struct bench_options {
+    std::size_t repetitions = 5;
+    std::size_t num_moves = 100'000;
+    std::vector<std::size_t> sizes{ 1'000, 10'000, 100'000 };
+    std::string filter;
+    bool csv = false;
+};
+
+struct bench_summary {
+    double min;
+    double median;
+    double mean;
+    double stddev;
+};
+
+bench_summary summarize(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    double mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+    double sum_sq = std::accumulate(values.begin(), values.end(), 0.0,
+        [&](double prev, double v) { return prev + (v - mean) * (v - mean); });
+    std::size_t mid = values.size() / 2;
+    double median = values.size() % 2 == 1 ? values[mid] : (values[mid - 1] + values[mid]) / 2;
+    double stddev = values.size() > 1 ? std::sqrt(sum_sq / (values.size() - 1)) : 0.0;
+    return bench_summary{ values.front(), median, mean, stddev };
+}
+
+#ifdef PLACER_ENABLE_PERF_COUNTERS
+const Utils::perf::event per_op_events[] = {
+    Utils::perf::event::cycles,
+    Utils::perf::event::instructions,
+    Utils::perf::event::llc_misses,
+    Utils::perf::event::branch_misses
+};
+
+void print_perf_header(const bench_options &options) {
+    for (Utils::perf::event e : per_op_events) {
+        if (options.csv) std::cout << "," << Utils::perf::event_name(e) << "_per_op";
+        else std::cout << std::setw(18) << Utils::perf::event_name(e) + std::string("/op");
+    }
+    if (options.csv) std::cout << ",ipc";
+    else std::cout << std::setw(8) << "ipc";
+}
+
+// Counts of the benchmarking thread only; stages that ran on pool workers are in the stage report,
+// which like the timings leaves out setup().
+void print_perf_columns(const bench_options &options, const Utils::perf::sample &totals, double num_ops) {
+    auto value = [&](Utils::perf::event e) { return static_cast<double>(totals.values[static_cast<std::size_t>(e)]); };
+    std::cout << std::fixed << std::setprecision(1);
+    for (Utils::perf::event e : per_op_events) {
+        if (options.csv) std::cout << ",";
+        else std::cout << std::setw(18);
+        if (Utils::perf::is_supported(totals, e)) std::cout << value(e) / num_ops;
+        else if (!options.csv) std::cout << "n/a";
+    }
+
+    bool has_ipc = Utils::perf::is_supported(totals, Utils::perf::event::cycles) &&
+                   Utils::perf::is_supported(totals, Utils::perf::event::instructions) &&
+                   value(Utils::perf::event::cycles) > 0;
+    std::cout << std::setprecision(2) << (options.csv ? "," : "");
+    if (!options.csv) std::cout << std::setw(8);
+    if (has_ipc) std::cout << value(Utils::perf::event::instructions) / value(Utils::perf::event::cycles);
+    else if (!options.csv) std::cout << "n/a";
+    std::cout.unsetf(std::ios::fixed);
+}
+#endif
+
+void print_header(const bench_options &options) {
+    if (options.csv) {
+        std::cout << "kernel,atoms,repetitions,ops,ns_per_op_median,ns_per_op_min,ns_per_op_mean,ns_per_op_stddev,"
+                  << "ops_per_sec,allocs_per_op";
+    }
+    else {
+        std::cout << std::left << std::setw(32) << "kernel" << std::right << std::setw(9) << "atoms"
+                  << std::setw(6) << "reps" << std::setw(10) << "ops" << std::setw(14) << "ns/op med"
+                  << std::setw(14) << "ns/op min" << std::setw(12) << "stddev %" << std::setw(14) << "ops/s"
+                  << std::setw(12) << "allocs/op";
+    }
+#ifdef PLACER_ENABLE_PERF_COUNTERS
+    print_perf_header(options);
+#endif
+    std::cout << "\n";
+}
+
+// Runs setup() untimed and body(state) timed once per repetition. Allocations made by body are
+// counted through the replaced global operator new.
+template <typename Setup, typename Body>
+void bench(const bench_options &options, const std::string &name, std::size_t num_atoms, std::size_t num_ops,
+    Setup &&setup, Body &&body)
+{
+    if (!options.filter.empty() && name.find(options.filter) == std::string::npos) return;
+
+    std::vector<double> ns_per_op;
+    std::vector<double> allocs_per_op;
+#ifdef PLACER_ENABLE_PERF_COUNTERS
+    Utils::perf::sample perf_totals;
+    perf_totals.supported = ~0u;
+    Utils::perf::stage_report perf_stages{};
+#endif
+    for (std::size_t i = 0; i < options.repetitions; ++i) {
+        auto state = setup();
+
+        std::size_t allocs_before = num_allocations.load(std::memory_order_relaxed);
+#ifdef PLACER_ENABLE_PERF_COUNTERS
+        Utils::perf::collect();
+        Utils::perf::sample perf_before = Utils::perf::read();
+#endif
+        auto start = std::chrono::steady_clock::now();
+        body(state);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+#ifdef PLACER_ENABLE_PERF_COUNTERS
+        Utils::perf::sample perf_delta = Utils::perf::difference(Utils::perf::read(), perf_before);
+        perf_totals.supported &= perf_delta.supported;
+        for (std::size_t e = 0; e < Utils::perf::num_events; ++e) perf_totals.values[e] += perf_delta.values[e];
+        Utils::perf::accumulate(perf_stages, Utils::perf::collect());
+#endif
+        std::size_t allocs_after = num_allocations.load(std::memory_order_relaxed);
+
+        ns_per_op.push_back(std::chrono::duration<double, std::nano>(elapsed).count() / num_ops);
+        allocs_per_op.push_back(static_cast<double>(allocs_after - allocs_before) / num_ops);
+    }
+
+    bench_summary ns = summarize(ns_per_op);
+    bench_summary allocs = summarize(allocs_per_op);
+    double ops_per_sec = 1e9 / ns.median;
+
+    if (options.csv) {
+        std::cout << name << "," << num_atoms << "," << options.repetitions << "," << num_ops << ","
+                  << ns.median << "," << ns.min << "," << ns.mean << "," << ns.stddev << ","
+                  << ops_per_sec << "," << allocs.median;
+    }
+    else {
+        std::cout << std::left << std::setw(32) << name << std::right << std::setw(9) << num_atoms
+                  << std::setw(6) << options.repetitions << std::setw(10) << num_ops << std::fixed
+                  << std::setprecision(1) << std::setw(14) << ns.median << std::setw(14) << ns.min
+                  << std::setw(12) << 100.0 * ns.stddev / ns.mean << std::setprecision(0) << std::setw(14) << ops_per_sec
+                  << std::setprecision(3) << std::setw(12) << allocs.median;
+        std::cout.unsetf(std::ios::fixed);
+    }
+#ifdef PLACER_ENABLE_PERF_COUNTERS
+    print_perf_columns(options, perf_totals, static_cast<double>(num_ops) * options.repetitions);
+#endif
+    std::cout << "\n";
+
+#ifdef PLACER_ENABLE_STATS
+    Utils::stats::report(name);
+#endif
+#ifdef PLACER_ENABLE_PERF_COUNTERS
+    Utils::perf::report(options.csv ? std::cerr : std::cout, name, perf_stages);
+#endif
+}
+
+struct no_state {};
+
+auto no_setup = []() { return no_state{}; };
+
+std::vector<std::pair<const Atom*, std::size_t>> random_moves(const Chip &chip, std::size_t num_moves) {
+    std::mt19937 eng;
+    std::bernoulli_distribution type_dist;
+    std::uniform_int_distribution<std::size_t> chip_dist{ 0, chip.get_width() * chip.get_height() / 2 - 1 };
+    std::uniform_int_distribution<std::size_t> lut_dist{ 0, chip.get_netlist().num_luts() - 1 };
+    std::uniform_int_distribution<std::size_t> ff_dist{ 0, chip.get_netlist().num_ffs() - 1 };
+
+    std::vector<std::pair<const Atom*, std::size_t>> moves;
+    moves.reserve(num_moves);
+    for (std::size_t i = 0; i < num_moves; ++i) {
+        const Atom &atom = type_dist(eng) ? Utils::get<Netlist::LUT>(chip.get_netlist(), lut_dist(eng)) :
+                                            Utils::get<Netlist::FF>(chip.get_netlist(), ff_dist(eng));
+        moves.emplace_back(&atom, chip_dist(eng));
+    }
+    return moves;
+}
+
+void run_benchmarks(const bench_options &options, std::size_t num_atoms) {
+    constexpr std::size_t num_phases = 3;
+    std::size_t num_luts = num_atoms / 2;
+    std::size_t num_ffs = num_atoms - num_luts;
+    std::size_t side = static_cast<std::size_t>(std::ceil(std::sqrt(5.0 * num_atoms)));
+    std::size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    bench(options, "random_netlist", num_atoms, num_atoms, no_setup, [&](no_state&) {
+        Utils::random_netlist(10, 5, num_luts, num_ffs, 3, 3, num_phases);
+    });
+
+    bench(options, "parallel_random_netlist/" + std::to_string(num_threads), num_atoms, num_atoms, no_setup, [&](no_state&) {
+        Utils::parallel_random_netlist(10, 5, num_luts, num_ffs, 3, 3, num_phases, num_threads);
+    });
+
+    Netlist netlist = Utils::random_netlist(10, 5, num_luts, num_ffs, 3, 3, num_phases);
+
+    bench(options, "chip_construction", num_atoms, num_atoms, no_setup, [&](no_state&) {
+        Chip chip{ side, side, netlist };
+    });
+
+    Chip chip{ side, side, netlist };
+    std::vector<std::pair<const Atom*, std::size_t>> moves = random_moves(chip, options.num_moves);
+
+    bench(options, "chip_initial_bbox", num_atoms, num_atoms, no_setup, [&](no_state&) {
+        chip.recompute_bbox();
+    });
+
+    bench(options, "chip_evaluate_swap", num_atoms, moves.size(), no_setup, [&](no_state&) {
+        std::int64_t sum = 0;
+        for (const auto &move : moves) sum += chip.evaluate_swap(*move.first, move.second);
+        RUNTIME_ASSERT(sum != std::numeric_limits<std::int64_t>::min());
+    });
+
+    bench(options, "chip_swap", num_atoms, moves.size(), [&]() { return chip.clone(); }, [&](Chip &clone) {
+        for (const auto &move : moves) clone.swap(*move.first, move.second);
+    });
+
+    std::pair<const char*, Utils::qp_solver> solvers[] = {
+        { "direct", Utils::qp_solver::direct },
+        { "cg_jacobi", Utils::qp_solver::conjugate_gradient_jacobi },
+        { "cg_ichol", Utils::qp_solver::conjugate_gradient_ichol }
+    };
+    for (const auto &solver : solvers) {
+        Utils::qp_options qp;
+        qp.solver = solver.second;
+        bench(options, std::string("qp_assemble_solve/") + solver.first, num_atoms, num_atoms, no_setup, [&](no_state&) {
+            Utils::quadratic_placement(side, side, netlist, 1, Plan::partitioning_method::bisection, num_phases, nullptr, qp);
+        });
+    }
+
+    std::pair<const char*, Plan::partitioning_method> methods[] = {
+        { "bisection", Plan::partitioning_method::bisection },
+        { "adaptive", Plan::partitioning_method::adaptive }
+    };
+    for (const auto &method : methods) {
+        Utils::thread_pool pool{ 1 };
+        bench(options, std::string("recursive_partition/") + method.first, num_atoms, num_atoms,
+            [&]() { return Utils::quadratic_placement(side, side, netlist, 1, method.second, num_phases); },
+            [&](Plan &plan) {
+                for (int level = 0; level < 4; ++level) plan.recursive_partition(level % 2 == 0, method.second, pool);
+            });
+    }
+
+    Plan plan = Utils::quadratic_placement(side, side, netlist, 4, Plan::partitioning_method::bisection, num_phases);
+
+    bench(options, "qp_assemble", num_atoms, num_atoms, no_setup, [&](no_state&) {
+        RUNTIME_ASSERT(Utils::assemble_qp_systems(plan, num_phases) > 0);
+    });
+
+    bench(options, "legalize_plan", num_atoms, num_atoms, no_setup, [&](no_state&) {
+        Chip legalized{ plan };
+    });
+}
+
+std::vector<std::size_t> parse_sizes(const std::string &arg) {
+    std::vector<std::size_t> sizes;
+    std::stringstream ss{ arg };
+    std::string size;
+    while (std::getline(ss, size, ',')) {
+        sizes.push_back(std::stoull(size));
+        RUNTIME_ASSERT(sizes.back() >= 2);
+    }
+    return sizes;
+}
+
+int main(int argc, char** argv) {
+    bench_options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--csv") {
+            options.csv = true;
+        }
+        else if (arg == "--repetitions" && i + 1 < argc) {
+            options.repetitions = std::stoull(argv[++i]);
+            RUNTIME_ASSERT(options.repetitions > 0);
+        }
+        else if (arg == "--moves" && i + 1 < argc) {
+            options.num_moves = std::stoull(argv[++i]);
+            RUNTIME_ASSERT(options.num_moves > 0);
+        }
+        else if (arg == "--sizes" && i + 1 < argc) {
+            options.sizes = parse_sizes(argv[++i]);
+        }
+        else if (arg == "--filter" && i + 1 < argc) {
+            options.filter = argv[++i];
+        }
+        else {
+            std::cerr << "usage: " << argv[0] << " [--repetitions N] [--moves N] [--sizes N,N,...] [--filter NAME] [--csv]\n";
+            return 1;
+        }
+    }
+
+    print_header(options);
+    for (std::size_t num_atoms : options.sizes) {
+        run_benchmarks(options, num_atoms);
+    }
+
+    return 0;
+}
\ No newline at end of file
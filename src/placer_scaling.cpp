@@ -0,0 +1,193 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "chip.h"
+#include "placement.h"
+
+struct scaling_options {
+    std::vector<std::size_t> sizes{ 1'000, 10'000, 100'000, 1'000'000 };
+    std::size_t moves_per_atom = 10;
+    int qp_levels = 2;
+    std::size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+    Utils::qp_solver solver = Utils::qp_solver::direct;
+};
+
+// Restarts the peak RSS counter so that every stage reports its own high-water mark. Kernels
+// without /proc/self/clear_refs fall back to the peak of the whole process.
+void reset_peak_rss() {
+    std::ofstream clear_refs{ "/proc/self/clear_refs" };
+    if (clear_refs) clear_refs << "5";
+}
+
+std::size_t peak_rss_kb() {
+    std::ifstream status{ "/proc/self/status" };
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) return std::stoull(line.substr(6));
+    }
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<std::size_t>(usage.ru_maxrss);
+}
+
+class scaling_report {
+
+public:
+
+    scaling_report(std::ostream &os)
+        :m_os{ os }
+    {
+        m_os << "engine,atoms,width,height,moves,wall_seconds,peak_rss_kb,bbox\n";
+    }
+
+    // Runs stage() and writes one CSV row with its wall time, its peak RSS and the bbox it returns.
+    template <typename Stage>
+    void run(const std::string &engine, std::size_t num_atoms, std::size_t side, std::size_t moves, Stage &&stage) {
+        std::cerr << engine << " on " << num_atoms << " atoms...\n";
+        reset_peak_rss();
+        auto start = std::chrono::steady_clock::now();
+        std::int64_t bbox = stage();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+
+        m_os << engine << "," << num_atoms << "," << side << "," << side << "," << moves << ","
+             << std::chrono::duration<double>(elapsed).count() << "," << peak_rss_kb() << "," << bbox << std::endl;
+    }
+
+private:
+
+    std::ostream &m_os;
+
+};
+
+void run_scaling(const scaling_options &options, scaling_report &report, std::size_t num_atoms) {
+    constexpr std::size_t num_phases = 3;
+    constexpr std::size_t num_temperatures = 5;
+    std::size_t num_luts = num_atoms / 2;
+    std::size_t num_ffs = num_atoms - num_luts;
+    std::size_t side = static_cast<std::size_t>(std::ceil(std::sqrt(5.0 * num_atoms)));
+    std::size_t num_moves = options.moves_per_atom * num_atoms;
+
+    Utils::qp_options qp;
+    qp.solver = options.solver;
+    qp.num_threads = options.num_threads;
+
+    std::unique_ptr<Netlist> netlist;
+    report.run("netlist", num_atoms, side, 0, [&]() {
+        netlist = std::make_unique<Netlist>(Utils::parallel_random_netlist(10, 5, num_luts, num_ffs, 3, 3, num_phases,
+                                                                           options.num_threads));
+        return std::int64_t(0);
+    });
+
+    std::unique_ptr<Chip> chip;
+    report.run("initial", num_atoms, side, 0, [&]() {
+        chip = std::make_unique<Chip>(side, side, *netlist);
+        return chip->get_bbox();
+    });
+
+    report.run("random", num_atoms, side, num_moves, [&]() {
+        Chip rand_chip{ chip->clone() };
+        Utils::random_placement(rand_chip, num_moves, nullptr);
+        return rand_chip.get_bbox();
+    });
+
+    report.run("sa", num_atoms, side, num_moves, [&]() {
+        Chip sim_chip{ chip->clone() };
+        Utils::simulated_annealing(sim_chip, num_temperatures, num_moves / num_temperatures, 0.5, 0.5, nullptr);
+        return sim_chip.get_bbox();
+    });
+
+    report.run("qp_adaptive", num_atoms, side, 0, [&]() {
+        Plan plan{ Utils::quadratic_placement(side, side, *netlist, options.qp_levels,
+            Plan::partitioning_method::adaptive, num_phases, nullptr, qp) };
+        return Chip{ plan }.get_bbox();
+    });
+
+    std::unique_ptr<Chip> bisection_chip;
+    report.run("qp_bisection", num_atoms, side, 0, [&]() {
+        Plan plan{ Utils::quadratic_placement(side, side, *netlist, options.qp_levels,
+            Plan::partitioning_method::bisection, num_phases, nullptr, qp) };
+        bisection_chip = std::make_unique<Chip>(plan);
+        return bisection_chip->get_bbox();
+    });
+
+    report.run("qp_bisection_sa", num_atoms, side, num_moves, [&]() {
+        Utils::simulated_annealing(*bisection_chip, num_temperatures, num_moves / num_temperatures, 0.5, 0.5, nullptr);
+        return bisection_chip->get_bbox();
+    });
+}
+
+std::vector<std::size_t> parse_sizes(const std::string &arg) {
+    std::vector<std::size_t> sizes;
+    std::stringstream ss{ arg };
+    std::string size;
+    while (std::getline(ss, size, ',')) {
+        sizes.push_back(std::stoull(size));
+        RUNTIME_ASSERT(sizes.back() >= 2);
+    }
+    return sizes;
+}
+
+Utils::qp_solver parse_solver(const std::string &arg) {
+    if (arg == "direct") return Utils::qp_solver::direct;
+    if (arg == "cg_jacobi") return Utils::qp_solver::conjugate_gradient_jacobi;
+    if (arg == "cg_ichol") return Utils::qp_solver::conjugate_gradient_ichol;
+    throw std::runtime_error{ "unknown solver " + arg };
+}
+
+int main(int argc, char** argv) {
+    scaling_options options;
+    std::string output;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--sizes" && i + 1 < argc) {
+            options.sizes = parse_sizes(argv[++i]);
+        }
+        else if (arg == "--moves-per-atom" && i + 1 < argc) {
+            options.moves_per_atom = std::stoull(argv[++i]);
+        }
+        else if (arg == "--qp-levels" && i + 1 < argc) {
+            options.qp_levels = std::stoi(argv[++i]);
+            RUNTIME_ASSERT(options.qp_levels > 0);
+        }
+        else if (arg == "--qp-solver" && i + 1 < argc) {
+            options.solver = parse_solver(argv[++i]);
+        }
+        else if (arg == "--threads" && i + 1 < argc) {
+            options.num_threads = std::stoull(argv[++i]);
+            RUNTIME_ASSERT(options.num_threads > 0);
+        }
+        else if (arg == "--output" && i + 1 < argc) {
+            output = argv[++i];
+        }
+        else {
+            std::cerr << "usage: " << argv[0] << " [--sizes N,N,...] [--moves-per-atom N] [--qp-levels N]"
+                      << " [--qp-solver direct|cg_jacobi|cg_ichol] [--threads N] [--output FILE]\n";
+            return 1;
+        }
+    }
+
+    std::ofstream file;
+    if (!output.empty()) {
+        file.open(output);
+        RUNTIME_ASSERT(file);
+    }
+
+    scaling_report report{ output.empty() ? std::cout : file };
+    for (std::size_t num_atoms : options.sizes) {
+        run_scaling(options, report, num_atoms);
+    }
+
+    return 0;
+}
\ No newline at end of file
@@ -2,7 +2,9 @@
 // Distributed under the MIT Software License (See accompanying LICENSE file)
 
 #include <boost/range/combine.hpp>
+#include "perf_counters.h"
 #include "plan.h"
+#include "trace.h"
 
 void Plan::assign_coords(const Partition &partition, const std::vector<coord> &coords, const plan_region &bound) {
     RUNTIME_ASSERT(partition.size() == coords.size());
@@ -24,11 +26,24 @@ void Plan::assign_coords(const Partition &partition, const std::vector<coord> &c
 }
 
 void Plan::recursive_partition(bool split_vertically, partitioning_method method) {
+    Utils::thread_pool pool{ 1 };
+    recursive_partition(split_vertically, method, pool);
+}
+
+void Plan::recursive_partition(bool split_vertically, partitioning_method method, Utils::thread_pool &pool) {
+    PLACER_TRACE_SPAN_ARG("recursive_partition", "partitions", m_partitions.size());
     auto old_partitions = std::move(m_partitions);
     auto old_bounds = std::move(m_partition_bounds);
 
-    m_partitions.reserve(old_partitions.size() * 2);
-    m_partition_bounds.reserve(old_bounds.size() * 2);
+    std::vector<std::size_t> offsets(old_partitions.size() + 1, 0);
+    for (std::size_t i = 0; i < old_partitions.size(); ++i) {
+        offsets[i + 1] = offsets[i] + (old_partitions[i].size() == 0 ? 1 : 2);
+    }
+
+    m_partitions.clear();
+    m_partitions.resize(offsets.back());
+    m_partition_bounds.clear();
+    m_partition_bounds.resize(offsets.back());
 
     auto sort_by_coord = [&](const Atom* lhs, const Atom* rhs) {
         const coord &lhs_c = m_board.at(lhs);
@@ -37,13 +52,15 @@ void Plan::recursive_partition(bool split_vertically, partitioning_method method
                                     coord::y_major_lt(lhs_c, rhs_c);
     };
 
-    for (auto entry : boost::combine(old_partitions, old_bounds)) {
-        Partition &partition = boost::get<0>(entry);
-        const plan_region &region = boost::get<1>(entry);
+    pool.parallel_for(0, old_partitions.size(), [&](std::size_t i) {
+        PLACER_PERF_STAGE(qp_partition);
+        Partition &partition = old_partitions[i];
+        const plan_region &region = old_bounds[i];
+        std::size_t out = offsets[i];
 
         if (partition.size() == 0) {
-            m_partition_bounds.emplace_back(region);
-            m_partitions.emplace_back(std::move(partition));
+            m_partition_bounds[out] = region;
+            m_partitions[out] = std::move(partition);
         }
         else {
             auto mid_iter = partition.begin() + partition.size() / 2;
@@ -54,23 +71,23 @@ void Plan::recursive_partition(bool split_vertically, partitioning_method method
                                           region.first.begin + (region.first.end - region.first.begin) / 2;
                 mid_x = std::max(region.first.begin, mid_x);
                 mid_x = std::min(region.first.end, mid_x);
-                m_partition_bounds.emplace_back(bound{ region.first.begin, mid_x }, region.second);
-                m_partition_bounds.emplace_back(bound{ mid_x, region.first.end }, region.second);
+                m_partition_bounds[out] = plan_region{ bound{ region.first.begin, mid_x }, region.second };
+                m_partition_bounds[out + 1] = plan_region{ bound{ mid_x, region.first.end }, region.second };
             }
             else {
                 double mid_y = (method == partitioning_method::adaptive) ? get_coord(**mid_iter).y :
                                           region.second.begin + (region.second.end - region.second.begin) / 2;
                 mid_y = std::max(region.second.begin, mid_y);
                 mid_y = std::min(region.second.end, mid_y);
-                m_partition_bounds.emplace_back(region.first, bound{ region.second.begin, mid_y });
-                m_partition_bounds.emplace_back(region.first, bound{ mid_y, region.second.end });
+                m_partition_bounds[out] = plan_region{ region.first, bound{ region.second.begin, mid_y } };
+                m_partition_bounds[out + 1] = plan_region{ region.first, bound{ mid_y, region.second.end } };
             }
 
-            m_partitions.emplace_back(mid_iter, partition.end());
+            m_partitions[out].assign(mid_iter, partition.end());
             partition.erase(mid_iter, partition.end());
-            m_partitions.emplace_back(std::move(partition));
+            m_partitions[out + 1] = std::move(partition);
         }
-    }
+    });
 }
 
 void Plan::initial_setup() {
@@ -85,6 +102,14 @@ void Plan::initial_setup() {
         m_board.emplace(&atom, coord{ 0.0, 0.0 });
     };
 
+    m_pin_coords.reserve(m_netlist.num_ipins() + m_netlist.num_opins());
+    for (std::size_t i = 0; i < m_netlist.num_ipins(); ++i) {
+        m_pin_coords.push_back(coord{ -1.0, static_cast<double>(i * (m_height / m_netlist.num_ipins())) });
+    }
+    for (std::size_t i = 0; i < m_netlist.num_opins(); ++i) {
+        m_pin_coords.push_back(coord{ static_cast<double>(m_width), static_cast<double>(i * (m_height / m_netlist.num_opins())) });
+    }
+
     m_partitions.emplace_back(std::move(initial_partiton));
     m_partition_bounds.emplace_back(bound{ 0.0, static_cast<double>(m_height) },
                                     bound{ 0.0, static_cast<double>(m_width) });
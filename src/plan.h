@@ -3,11 +3,12 @@
 
 #pragma once
 
-#include <boost/bimap.hpp>
 #include <boost/optional.hpp>
+#include <memory>
 #include <unordered_map>
 
-#include "netlist.h"
+#include "flat_netlist.h"
+#include "thread_pool.h"
 
 class Plan {
 
@@ -47,7 +48,8 @@ public:
     Plan(std::size_t width, std::size_t height, const Netlist &netlist)
         :m_width{ width },
         m_height{ height },
-        m_netlist{ netlist }
+        m_netlist{ netlist },
+        m_flat{ std::make_shared<FlatNetlist>(netlist) }
     {
         RUNTIME_ASSERT(width * height >= 2 * std::max(netlist.num_ffs(), netlist.num_luts()));
         RUNTIME_ASSERT(height >= netlist.num_ipins());
@@ -59,6 +61,8 @@ public:
         :m_width{ other.m_width },
         m_height{ other.m_height },
         m_netlist{ other.m_netlist },
+        m_flat{ std::move(other.m_flat) },
+        m_pin_coords{ std::move(other.m_pin_coords) },
         m_partitions{ std::move(other.m_partitions) },
         m_partition_bounds{ std::move(other.m_partition_bounds) },
         m_board{ std::move(other.m_board) }
@@ -70,6 +74,8 @@ public:
     const std::size_t get_height() const { return m_height; }
 
     inline const Netlist &get_netlist() const { return m_netlist; }
+    inline const FlatNetlist &get_flat_netlist() const { return *m_flat; }
+    inline const std::shared_ptr<const FlatNetlist> &share_flat_netlist() const { return m_flat; }
 
     inline auto &partitions() { return m_partitions; }
     inline auto &partitions() const { return m_partitions; }
@@ -118,21 +124,23 @@ public:
     }
 
     inline boost::optional<coord> get_coord(const IPin &ipin) const {
-        auto iter = std::find_if(ipins().begin(), ipins().end(),
-            [&](const IPin &i) { return &i == &ipin; });
-        if (iter == ipins().end()) return boost::none;
-        return coord{ -1.0, static_cast<double>((iter - ipins().begin()) * (m_height / m_netlist.num_ipins())) };
+        if (ipin.get_type() != Atom::type::IPIN) return boost::none;
+        return m_pin_coords[m_flat->atom_id(ipin) - m_flat->ipin_begin()];
     }
 
     inline boost::optional<coord> get_coord(const OPin &opin) const {
-        auto iter = std::find_if(opins().begin(), opins().end(),
-            [&](const OPin &o) { return &o == &opin; });
-        if (iter == opins().end()) return boost::none;
-        return coord{ static_cast<double>(m_width), static_cast<double>((iter - opins().begin()) * (m_height / m_netlist.num_opins())) };
+        if (opin.get_type() != Atom::type::OPIN) return boost::none;
+        return m_pin_coords[m_flat->atom_id(opin) - m_flat->ipin_begin()];
+    }
+
+    inline coord get_coord(FlatNetlist::id_type id) const {
+        if (m_flat->is_cell(id)) return get_coord(m_flat->get_atom(id));
+        return m_pin_coords[id - m_flat->ipin_begin()];
     }
 
     void assign_coords(const Partition &partition, const std::vector<coord> &coords, const plan_region &bound);
     void recursive_partition(bool split_horizontally, partitioning_method method);
+    void recursive_partition(bool split_horizontally, partitioning_method method, Utils::thread_pool &pool);
 
 private:
 
@@ -141,6 +149,8 @@ private:
     std::size_t m_width;
     std::size_t m_height;
     const Netlist &m_netlist;
+    std::shared_ptr<const FlatNetlist> m_flat;
+    std::vector<coord> m_pin_coords;
     std::vector<Partition> m_partitions;
     std::vector<plan_region> m_partition_bounds;
     std::unordered_map<const Atom*, coord> m_board;
@@ -5,27 +5,14 @@ from __future__ import print_function
 import matplotlib.pyplot as plt
 import sys
 
-SAVE_PLOTS = True
-
-def get_points(filepath):
-    try:
-        hfile = open(filepath)
-    except Exception as e:
-        sys.stderr.write("ERROR: " + filepath + " cannot be opened: " + str(e))
-        exit(1)
+from metrics_reader import read_iterations
 
-    points = []
-    for line in hfile:
-        line = line.strip()
-        if line != "":
-            points.append(int(line))
-
-    return points
+SAVE_PLOTS = True
 
-def plot_iterates(y_plot, ori_filepath):
+def plot_iterates(x_plot, y_plot, ori_filepath):
     fig = plt.figure(figsize=(8, 8))
 
-    plt.plot(y_plot)
+    plt.plot(x_plot, y_plot)
 
     plt.xlabel('k, iterations')
     plt.ylabel('BBOX distance')
@@ -45,5 +32,5 @@ if __name__ == "__main__":
     files = sys.argv[1:]
     for filepath in files:
         filepath = filepath.strip()
-        y_plot = get_points(filepath)
-        plot_iterates(y_plot, filepath)
\ No newline at end of file
+        x_plot, y_plot, _ = read_iterations(filepath)
+        plot_iterates(x_plot, y_plot, filepath)
\ No newline at end of file
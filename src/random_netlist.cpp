@@ -1,12 +1,11 @@
 // (C) Copyright Shou Hao Ho   2018
 // Distributed under the MIT Software License (See accompanying LICENSE file)
 
-#include <boost/property_tree/json_parser.hpp>
-#include <boost/property_tree/ptree.hpp>
 #include <fstream>
 #include <random>
 
 #include "netlist.h"
+#include "thread_pool.h"
 
 namespace Utils {
 
@@ -93,7 +92,8 @@ namespace Utils {
             }
         }
 
-        void connect_phases(const std::vector<std::vector<Atom*>> &phases, std::size_t num_connections, std::mt19937 &eng, std::size_t num_inputs, std::size_t num_outputs) {
+        template <typename Engine>
+        void connect_phases(const std::vector<std::vector<Atom*>> &phases, std::size_t num_connections, Engine &eng, std::size_t num_inputs, std::size_t num_outputs) {
             std::uniform_int_distribution<std::size_t> iport_dist{ 0, num_inputs - 1 };
             std::uniform_int_distribution<std::size_t> oport_dist{ 0, num_outputs - 1 };
             std::vector<std::uniform_int_distribution<std::size_t>> atom_dist;
@@ -120,6 +120,108 @@ namespace Utils {
             }
         }
 
+        std::vector<std::vector<Atom*>> split_phases(Netlist &netlist, std::size_t num_phases) {
+            std::size_t num_luts_per_phase = netlist.num_luts() / num_phases;
+            std::size_t num_ffs_per_phase = netlist.num_ffs() / num_phases;
+
+            std::vector<std::vector<Atom*>> phases;
+            auto lut_iter = netlist.begin_luts();
+            auto ff_iter = netlist.begin_ffs();
+
+            for (std::size_t i = 0; i < num_phases - 1; ++i) {
+                std::vector<Atom*> phase;
+                phase.reserve(num_luts_per_phase + num_ffs_per_phase);
+                std::transform(lut_iter, lut_iter + num_luts_per_phase, std::back_inserter(phase),
+                    [](Atom &atom) { return &atom; });
+                std::transform(ff_iter, ff_iter + num_ffs_per_phase, std::back_inserter(phase),
+                    [](Atom &atom) { return &atom; });
+                for (Atom* atom : phase) atom->set_phase(i);
+
+                phases.emplace_back(std::move(phase));
+
+                lut_iter += num_luts_per_phase;
+                ff_iter += num_ffs_per_phase;
+            }
+            {
+                std::vector<Atom*> phase;
+                phase.reserve(netlist.num_ffs() + netlist.num_luts() - (num_luts_per_phase + num_ffs_per_phase) * (num_phases - 1));
+                std::transform(lut_iter, netlist.end_luts(), std::back_inserter(phase),
+                    [](Atom &atom) { return &atom; });
+                std::transform(ff_iter, netlist.end_ffs(), std::back_inserter(phase),
+                    [](Atom &atom) { return &atom; });
+                for (Atom* atom : phase) atom->set_phase(num_phases - 1);
+
+                phases.emplace_back(std::move(phase));
+            }
+
+            return phases;
+        }
+
+        constexpr std::size_t atoms_per_chunk = 4096;
+
+        // Counter-based stream: the n-th number is a hash of (key, n), so streams need no state
+        // beyond a counter and any number of them can be created cheaply and independently.
+        class counter_engine {
+
+        public:
+
+            using result_type = std::uint64_t;
+
+            counter_engine(std::uint64_t seed, std::uint64_t stream)
+                :m_key{ mix(seed ^ mix(stream + 0x9e3779b97f4a7c15ull)) },
+                m_counter{ 0 }
+            {}
+
+            static constexpr result_type min() { return 0; }
+            static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+            inline result_type operator()() { return mix(m_key + ++m_counter * 0x9e3779b97f4a7c15ull); }
+
+        private:
+
+            static inline std::uint64_t mix(std::uint64_t z) {
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+                return z ^ (z >> 31);
+            }
+
+            std::uint64_t m_key;
+            std::uint64_t m_counter;
+
+        };
+
+        struct random_edge {
+            IPort* iport;
+            OPort* oport;
+        };
+
+        // Same draws as random_front_phase/random_phase restricted to phase[begin, end). Edges are
+        // only recorded, the netlist is left untouched so that chunks can run concurrently.
+        void random_phase_chunk(Netlist &netlist, const std::vector<Atom*> &phase, std::size_t begin, std::size_t end,
+            bool front, counter_engine &eng, std::size_t num_outputs, std::size_t num_ipins, double connect_prob,
+            std::vector<random_edge> &edges)
+        {
+            std::size_t atom_skew = front ? phase.size() / 15 : 0;
+
+            std::uniform_real_distribution<> connect_dist{ 0.0, 1.0 };
+            std::uniform_int_distribution<std::size_t> atom_dist{ 0, phase.size() - 1 };
+            std::uniform_int_distribution<std::size_t> oport_dist{ 0, front ? num_outputs*atom_skew + num_ipins - 1 : num_outputs - 1 };
+            std::uniform_int_distribution<std::size_t> ipin_dist{ 0, num_ipins - 1 };
+
+            for (std::size_t i = begin; i < end; ++i) {
+                for (IPort &iport : phase[i]->inputs()) {
+                    if (!iport.has_fanin() && connect_dist(eng) < connect_prob) {
+                        Atom &lucky_atom = *phase[atom_dist(eng)];
+                        std::size_t idx = oport_dist(eng);
+                        OPort &lucky_oport = !front ? lucky_atom.get_oport(idx) :
+                                             idx / num_outputs < atom_skew ? lucky_atom.get_oport(idx % num_outputs) :
+                                                                             get<IPin>(netlist, ipin_dist(eng)).get_oport();
+                        edges.push_back(random_edge{ &iport, &lucky_oport });
+                    }
+                }
+            }
+        }
+
     }
 
     Netlist random_netlist(std::size_t num_ipins, std::size_t num_opins, std::size_t num_luts,
@@ -136,39 +238,9 @@ namespace Utils {
         constexpr double connect_prob = 0.25;
         constexpr std::size_t max_outputs = 10000;
 
-        std::size_t num_luts_per_phase = num_luts / num_phases;
-        std::size_t num_ffs_per_phase = num_ffs / num_phases;
         Netlist netlist{ num_ipins, num_opins, num_luts, num_ffs, num_inputs, num_outputs, max_outputs };
 
-        std::vector<std::vector<Atom*>> phases;
-        auto lut_iter = netlist.begin_luts();
-        auto ff_iter = netlist.begin_ffs();
-
-        for (std::size_t i = 0; i < num_phases - 1; ++i) {
-            std::vector<Atom*> phase;
-            phase.reserve(num_luts_per_phase + num_ffs_per_phase);
-            std::transform(lut_iter, lut_iter + num_luts_per_phase, std::back_inserter(phase),
-                [](Atom &atom) { return &atom; });
-            std::transform(ff_iter, ff_iter + num_ffs_per_phase, std::back_inserter(phase),
-                [](Atom &atom) { return &atom; });
-            for (Atom* atom : phase) atom->set_phase(i);
-
-            phases.emplace_back(std::move(phase));
-
-            lut_iter += num_luts_per_phase;
-            ff_iter += num_ffs_per_phase;
-        }
-        {
-            std::vector<Atom*> phase;
-            phase.reserve(num_ffs + num_luts - (num_luts_per_phase + num_ffs_per_phase) * (num_phases - 1));
-            std::transform(lut_iter, netlist.end_luts(), std::back_inserter(phase),
-                [](Atom &atom) { return &atom; });
-            std::transform(ff_iter, netlist.end_ffs(), std::back_inserter(phase),
-                [](Atom &atom) { return &atom; });
-            for (Atom* atom : phase) atom->set_phase(num_phases - 1);
-
-            phases.emplace_back(std::move(phase));
-        }
+        std::vector<std::vector<Atom*>> phases = impl::split_phases(netlist, num_phases);
 
         std::mt19937 eng;
 
@@ -185,73 +257,254 @@ namespace Utils {
         return netlist;
     }
 
-    namespace impl {
+    Netlist parallel_random_netlist(std::size_t num_ipins, std::size_t num_opins, std::size_t num_luts, std::size_t num_ffs,
+        std::size_t num_inputs, std::size_t num_outputs, std::size_t num_phases, std::size_t num_threads, std::uint64_t seed)
+    {
+        RUNTIME_ASSERT(num_ipins > 0);
+        RUNTIME_ASSERT(num_opins > 0);
+        RUNTIME_ASSERT(num_luts > 0);
+        RUNTIME_ASSERT(num_ffs > 0);
+        RUNTIME_ASSERT(num_inputs > 0);
+        RUNTIME_ASSERT(num_outputs > 0);
+        RUNTIME_ASSERT(num_phases > 0);
 
-        template <typename T>
-        auto ptr_str(const T &val) {
-            return std::to_string(reinterpret_cast<std::intptr_t>(&val));
-        };
+        constexpr double connect_prob = 0.25;
+        constexpr std::size_t max_outputs = 10000;
 
-        template <typename T>
-        auto unnamed_node(const T &val) {
-            boost::property_tree::ptree node;
-            node.put("", ptr_str(val));
-            return node;
+        Netlist netlist{ num_ipins, num_opins, num_luts, num_ffs, num_inputs, num_outputs, max_outputs };
+
+        std::vector<std::vector<Atom*>> phases = impl::split_phases(netlist, num_phases);
+
+        // Streams 0..num_phases-1 belong to the phases (chunk index in the upper half), the two
+        // streams after them drive the serial cross-phase and output pin connections.
+        impl::counter_engine cross_eng{ seed, num_phases };
+        if (phases.size() > 1) {
+            impl::connect_phases(phases, num_phases * (num_phases - 1) / 2 * 10, cross_eng, num_inputs, num_outputs);
+        }
+
+        impl::counter_engine opin_eng{ seed, num_phases + 1 };
+        std::uniform_int_distribution<std::size_t> last_atom_dist{ 0, phases.back().size() - 1 };
+        std::uniform_int_distribution<std::size_t> oport_dist{ 0, num_outputs - 1 };
+        for (OPin &opin : netlist.opins()) {
+            Atom &lucky_atom = *phases.back()[last_atom_dist(opin_eng)];
+            connect(opin.get_iport(), lucky_atom.get_oport(oport_dist(opin_eng)));
+        }
+
+        struct chunk {
+            std::size_t phase;
+            std::size_t begin;
+            std::size_t end;
         };
 
-        auto expand_port(const OPort &oport) {
-            boost::property_tree::ptree node;
-            for (const IPort* iport : boost::make_iterator_range(oport.begin(), oport.end())) {
-                node.push_back(std::make_pair("", unnamed_node(*iport)));
+        std::vector<chunk> chunks;
+        for (std::size_t p = 0; p < phases.size(); ++p) {
+            for (std::size_t begin = 0; begin < phases[p].size(); begin += impl::atoms_per_chunk) {
+                chunks.push_back(chunk{ p, begin, std::min(phases[p].size(), begin + impl::atoms_per_chunk) });
             }
-            return node;
         }
 
-        auto expand_port(const IPort &iport) {
-            boost::property_tree::ptree node;
-            if (iport.has_fanin()) {
-                node.push_back(std::make_pair("", unnamed_node(*(iport.fanin()))));
+        // Chunks only read the netlist and each one visits a disjoint set of input ports, so the
+        // edges it draws do not depend on the other chunks. They are then connected in chunk order,
+        // which fixes the order of every fanout list independently of the thread count.
+        std::vector<std::vector<impl::random_edge>> edges(chunks.size());
+        {
+            thread_pool pool{ num_threads };
+            pool.parallel_for(0, chunks.size(), [&](std::size_t c) {
+                const chunk &ch = chunks[c];
+                impl::counter_engine eng{ seed, (static_cast<std::uint64_t>(ch.begin / impl::atoms_per_chunk) << 32) | ch.phase };
+                edges[c].reserve(static_cast<std::size_t>((ch.end - ch.begin) * num_inputs * connect_prob));
+                impl::random_phase_chunk(netlist, phases[ch.phase], ch.begin, ch.end, ch.phase == 0, eng,
+                                         num_outputs, num_ipins, connect_prob, edges[c]);
+            });
+        }
+
+        for (const auto &chunk_edges : edges) {
+            for (const impl::random_edge &edge : chunk_edges) {
+                connect(*edge.iport, *edge.oport);
             }
-            return node;
         }
+
+        return netlist;
     }
 
-    void dump_netlist(const Netlist &netlist, const std::string &filepath) {
-        boost::property_tree::ptree tree;
+    namespace impl {
 
-        auto port_nodes = [&](const auto &ports) {
-            boost::property_tree::ptree node;
-            for (const auto &port : ports) {
-                node.add_child(impl::ptr_str(port), impl::expand_port(port));
+        // Produces the same text as boost::property_tree::write_json on the old ptree layout:
+        // every value is a string, an empty node is "", and a node whose children are all unnamed
+        // is an array. Nothing is buffered beyond the output stream.
+        class netlist_json_writer {
+
+        public:
+
+            netlist_json_writer(const Netlist &netlist, std::ostream &os, netlist_ids ids)
+                :m_netlist{ netlist },
+                m_os{ os },
+                m_ids{ ids },
+                m_cell_inputs{ 0 },
+                m_cell_outputs{ 0 }
+            {
+                const Atom* cell = netlist.num_luts() > 0 ? &*netlist.begin_luts() :
+                                   netlist.num_ffs() > 0 ? &*netlist.begin_ffs() : nullptr;
+                if (cell != nullptr) {
+                    m_cell_inputs = cell->inputs().size();
+                    m_cell_outputs = cell->outputs().size();
+                }
+            }
+
+            void write() {
+                std::uint64_t num_cells = m_netlist.num_luts() + m_netlist.num_ffs();
+
+                m_os << "{\n";
+                write_atoms("IPins", m_netlist.ipins(), num_cells, false);
+                write_atoms("OPins", m_netlist.opins(), num_cells + m_netlist.num_ipins(), false);
+                write_atoms("LUTs", m_netlist.luts(), 0, false);
+                write_atoms("FFs", m_netlist.ffs(), m_netlist.num_luts(), true);
+                m_os << "}\n";
+            }
+
+        private:
+
+            template <typename Atoms>
+            void write_atoms(const char* name, const Atoms &atoms, std::uint64_t first_id, bool last) {
+                indent(1);
+                m_os << "\"" << name << "\": ";
+                if (atoms.empty()) {
+                    m_os << "\"\"";
+                }
+                else {
+                    m_os << "{\n";
+                    std::uint64_t id = first_id;
+                    for (auto iter = atoms.begin(); iter != atoms.end(); ++iter, ++id) {
+                        write_atom(*iter, m_ids == netlist_ids::pointer ? pointer_id(*iter) : id,
+                                   iter + 1 == atoms.end());
+                    }
+                    indent(1);
+                    m_os << "}";
+                }
+                m_os << (last ? "\n" : ",\n");
+            }
+
+            void write_atom(const Atom &atom, std::uint64_t id, bool last) {
+                indent(2);
+                write_id(id);
+                m_os << ": {\n";
+
+                indent(3);
+                m_os << "\"iports\": ";
+                write_ports(atom.inputs(), [&](const IPort &iport) {
+                    if (!iport.has_fanin()) return false;
+                    m_os << "[\n";
+                    indent(5);
+                    write_id(oport_id(*iport.fanin()));
+                    m_os << "\n";
+                    indent(4);
+                    m_os << "]";
+                    return true;
+                }, [&](const IPort &iport) { return iport_id(iport); });
+
+                indent(3);
+                m_os << "\"oports\": ";
+                write_ports(atom.outputs(), [&](const OPort &oport) {
+                    if (oport.empty()) return false;
+                    m_os << "[\n";
+                    for (auto iter = oport.begin(); iter != oport.end(); ++iter) {
+                        indent(5);
+                        write_id(iport_id(**iter));
+                        m_os << (iter + 1 == oport.end() ? "\n" : ",\n");
+                    }
+                    indent(4);
+                    m_os << "]";
+                    return true;
+                }, [&](const OPort &oport) { return oport_id(oport); });
+
+                indent(3);
+                m_os << "\"phase\": \"" << atom.get_phase() << "\"\n";
+
+                indent(2);
+                m_os << (last ? "}\n" : "},\n");
+            }
+
+            template <typename Ports, typename ValueFunc, typename IdFunc>
+            void write_ports(const Ports &ports, ValueFunc &&write_value, IdFunc &&id_of) {
+                if (ports.empty()) {
+                    m_os << "\"\",\n";
+                    return;
+                }
+
+                m_os << "{\n";
+                for (auto iter = ports.begin(); iter != ports.end(); ++iter) {
+                    indent(4);
+                    write_id(id_of(*iter));
+                    m_os << ": ";
+                    if (!write_value(*iter)) m_os << "\"\"";
+                    m_os << (iter + 1 == ports.end() ? "\n" : ",\n");
+                }
+                indent(3);
+                m_os << "},\n";
             }
-            return node;
-        };
 
-        auto add_atoms = [&](const std::string &name, const auto &atoms) {
-            boost::property_tree::ptree atoms_arr;
-            for (const auto &atom : atoms) {
-                boost::property_tree::ptree atom_node;
-                atom_node.add_child("iports", port_nodes(atom.inputs()));
-                atom_node.add_child("oports", port_nodes(atom.outputs()));
+            template <typename T>
+            static std::uint64_t pointer_id(const T &val) {
+                return static_cast<std::uint64_t>(reinterpret_cast<std::intptr_t>(&val));
+            }
+
+            // Integer port ids number the inputs (and separately the outputs) of all atoms in atom
+            // order. Every LUT and FF has the same port counts, so the ids are pure arithmetic.
+            std::uint64_t first_port(const Atom &atom, std::uint64_t cell_ports) const {
+                std::uint64_t num_cells = m_netlist.num_luts() + m_netlist.num_ffs();
+                switch (atom.get_type()) {
+                case Atom::type::LUT:
+                    return (&atom - Access::get_luts(m_netlist).data()) * cell_ports;
+                case Atom::type::FF:
+                    return (m_netlist.num_luts() + (&atom - Access::get_ffs(m_netlist).data())) * cell_ports;
+                case Atom::type::IPIN:
+                    return num_cells * cell_ports + (static_cast<const IPin*>(&atom) - Access::get_ipins(m_netlist).data());
+                case Atom::type::OPIN:
+                    return num_cells * cell_ports + (static_cast<const OPin*>(&atom) - Access::get_opins(m_netlist).data());
+                }
+                return 0;
+            }
 
-                boost::property_tree::ptree phase_node;
-                phase_node.put("", atom.get_phase());
-                atom_node.push_back(std::make_pair("phase", phase_node));
+            std::uint64_t iport_id(const IPort &iport) const {
+                if (m_ids == netlist_ids::pointer) return pointer_id(iport);
+                const Atom &atom = iport.get_atom();
+                return first_port(atom, m_cell_inputs) + (&iport - &*atom.begin_inputs());
+            }
+
+            std::uint64_t oport_id(const OPort &oport) const {
+                if (m_ids == netlist_ids::pointer) return pointer_id(oport);
+                const Atom &atom = oport.get_atom();
+                return first_port(atom, m_cell_outputs) + (&oport - &*atom.begin_outputs());
+            }
 
-                atoms_arr.add_child(impl::ptr_str(atom), atom_node);
+            void write_id(std::uint64_t id) {
+                m_os << "\"" << id << "\"";
             }
-            tree.add_child(name, atoms_arr);
+
+            void indent(std::size_t level) {
+                for (std::size_t i = 0; i < level; ++i) m_os << "    ";
+            }
+
+            const Netlist &m_netlist;
+            std::ostream &m_os;
+            netlist_ids m_ids;
+            std::uint64_t m_cell_inputs;
+            std::uint64_t m_cell_outputs;
+
         };
 
-        add_atoms("IPins", netlist.ipins());
-        add_atoms("OPins", netlist.opins());
-        add_atoms("LUTs", netlist.luts());
-        add_atoms("FFs", netlist.ffs());
+    }
+
+    void dump_netlist(const Netlist &netlist, const std::string &filepath, netlist_ids ids) {
+        constexpr std::size_t buffer_size = 1 << 20;
+        std::vector<char> buffer(buffer_size);
 
-        std::ofstream hfile{ filepath, std::ios::binary };
+        std::ofstream hfile;
+        hfile.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+        hfile.open(filepath, std::ios::binary);
         RUNTIME_ASSERT(hfile.is_open());
 
-        boost::property_tree::write_json(hfile, tree);
+        impl::netlist_json_writer{ netlist, hfile, ids }.write();
         hfile.flush();
         RUNTIME_ASSERT(hfile);
     }
@@ -1,9 +1,11 @@
 // (C) Copyright Shou Hao Ho   2018
 // Distributed under the MIT Software License (See accompanying LICENSE file)
 
+#include <fstream>
 #include <iostream>
 
 #include "chip.h"
+#include "experiment.h"
 #include "placement.h"
 
 void run_demos() {
@@ -96,6 +98,14 @@ void run_num_iterations_experiments(const Chip &chip) {
         Utils::simulated_annealing(expr_chip, 5, i / 5, 0.5, 0.5, nullptr);
         std::cout << expr_chip.get_bbox() << "\n";
     }
+
+    {
+        std::cout << "Simulated annealing with adaptive schedule. BBOX = ";
+
+        Chip expr_chip{ chip.clone() };
+        Utils::simulated_annealing(expr_chip, Utils::anneal_schedule{}, 0, nullptr);
+        std::cout << expr_chip.get_bbox() << "\n";
+    }
 }
 
 void run_num_recursions_experiments(const Chip &chip, std::size_t num_phases) {
@@ -246,7 +256,23 @@ void run_num_atoms_experiments() {
     }
 }
 
-int main() {
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        if (argc > 3) {
+            std::cerr << "usage: " << argv[0] << " [spec.json [results.jsonl]]\n";
+            return 1;
+        }
+        if (argc == 3) {
+            std::ofstream results{ argv[2] };
+            RUNTIME_ASSERT(results);
+            Utils::run_experiments(argv[1], results);
+        }
+        else {
+            Utils::run_experiments(argv[1], std::cout);
+        }
+        return 0;
+    }
+
     std::cout << "Running demo...\n";
     run_demos();
     std::cout << "\n";
@@ -0,0 +1,182 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#include "stats.h"
+
+#ifdef PLACER_ENABLE_STATS
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Utils {
+
+    namespace stats {
+
+        namespace {
+
+#define PLACER_STATS_NAME(NAME) #NAME,
+            const char* const counter_names[] = { PLACER_STATS_COUNTERS(PLACER_STATS_NAME) };
+            const char* const timer_names[] = { PLACER_STATS_TIMERS(PLACER_STATS_NAME) };
+#undef PLACER_STATS_NAME
+
+            // Shards are owned by the registry rather than by their threads, so the counts of a
+            // finished thread pool still show up in the next report.
+            struct registry {
+                std::mutex mutex;
+                std::vector<std::unique_ptr<shard>> shards;
+            };
+
+            registry &get_registry() {
+                static registry instance;
+                return instance;
+            }
+
+            struct timer_totals {
+                std::uint64_t count = 0;
+                std::uint64_t total_ns = 0;
+                std::array<std::uint64_t, num_buckets> buckets{};
+            };
+
+            std::size_t bucket_of(std::uint64_t ns) {
+                std::size_t bucket = 0;
+                while (ns > 1 && bucket + 1 < num_buckets) {
+                    ns >>= 1;
+                    ++bucket;
+                }
+                return bucket;
+            }
+
+            std::uint64_t percentile(const timer_totals &totals, double p) {
+                std::uint64_t target = static_cast<std::uint64_t>(p * totals.count);
+                std::uint64_t seen = 0;
+                for (std::size_t b = 0; b < num_buckets; ++b) {
+                    seen += totals.buckets[b];
+                    if (seen > target) return std::uint64_t(2) << b;
+                }
+                return std::uint64_t(2) << (num_buckets - 1);
+            }
+
+            template <typename T>
+            void reset(std::atomic<T> &value) { value.store(0, std::memory_order_relaxed); }
+
+            std::atomic<std::uint64_t> num_scopes_started{ 0 };
+            std::atomic<std::uint64_t> num_scopes_active{ 0 };
+
+        }
+
+        shard &local_shard() {
+            thread_local shard* local = nullptr;
+            if (local == nullptr) {
+                registry &reg = get_registry();
+                std::lock_guard<std::mutex> lock{ reg.mutex };
+                reg.shards.emplace_back(std::make_unique<shard>());
+                local = reg.shards.back().get();
+                for (auto &c : local->counters) reset(c);
+                for (timer_slot &slot : local->timers) {
+                    reset(slot.count);
+                    reset(slot.total_ns);
+                    for (auto &b : slot.buckets) reset(b);
+                }
+            }
+            return *local;
+        }
+
+        void record(timer t, std::uint64_t ns) {
+            timer_slot &slot = local_shard().timers[static_cast<std::size_t>(t)];
+            bump(slot.count, 1);
+            bump(slot.total_ns, ns);
+            bump(slot.buckets[bucket_of(ns)], 1);
+        }
+
+        report_scope_id begin_report_scope() {
+            bool overlapped = num_scopes_active.fetch_add(1) > 0;
+            return report_scope_id{ num_scopes_started.fetch_add(1) + 1, overlapped };
+        }
+
+        bool end_report_scope(const report_scope_id &id) {
+            num_scopes_active.fetch_sub(1);
+            return id.overlapped || num_scopes_started.load() != id.generation;
+        }
+
+        void report(std::ostream &os, const std::string &title, report_format format, bool overlapped) {
+            std::array<std::uint64_t, num_counters> counters{};
+            std::array<timer_totals, num_timers> timers{};
+            std::size_t num_shards = 0;
+
+            {
+                registry &reg = get_registry();
+                std::lock_guard<std::mutex> lock{ reg.mutex };
+                num_shards = reg.shards.size();
+                for (const auto &s : reg.shards) {
+                    for (std::size_t c = 0; c < num_counters; ++c) {
+                        counters[c] += s->counters[c].exchange(0, std::memory_order_relaxed);
+                    }
+                    for (std::size_t t = 0; t < num_timers; ++t) {
+                        timer_slot &slot = s->timers[t];
+                        timers[t].count += slot.count.exchange(0, std::memory_order_relaxed);
+                        timers[t].total_ns += slot.total_ns.exchange(0, std::memory_order_relaxed);
+                        for (std::size_t b = 0; b < num_buckets; ++b) {
+                            timers[t].buckets[b] += slot.buckets[b].exchange(0, std::memory_order_relaxed);
+                        }
+                    }
+                }
+            }
+
+            if (format == report_format::json) {
+                os << "{\"title\":\"" << title << "\",\"shards\":" << num_shards
+                   << ",\"overlapped\":" << (overlapped ? "true" : "false") << ",\"counters\":{";
+                for (std::size_t c = 0; c < num_counters; ++c) {
+                    os << (c == 0 ? "" : ",") << "\"" << counter_names[c] << "\":" << counters[c];
+                }
+                os << "},\"timers\":{";
+                bool first = true;
+                for (std::size_t t = 0; t < num_timers; ++t) {
+                    if (timers[t].count == 0) continue;
+                    os << (first ? "" : ",") << "\"" << timer_names[t] << "\":{\"count\":" << timers[t].count
+                       << ",\"total_ns\":" << timers[t].total_ns << ",\"log2_ns_histogram\":[";
+                    for (std::size_t b = 0; b < num_buckets; ++b) {
+                        os << (b == 0 ? "" : ",") << timers[t].buckets[b];
+                    }
+                    os << "]}";
+                    first = false;
+                }
+                os << "}}\n";
+                return;
+            }
+
+            os << "stats: " << title << " (" << num_shards << " shards" << (overlapped ? ", overlapped another placer" : "") << ")\n";
+            for (std::size_t c = 0; c < num_counters; ++c) {
+                if (counters[c] == 0) continue;
+                os << "  " << counter_names[c] << " = " << counters[c] << "\n";
+            }
+            for (std::size_t t = 0; t < num_timers; ++t) {
+                const timer_totals &totals = timers[t];
+                if (totals.count == 0) continue;
+                os << "  " << timer_names[t] << ": count = " << totals.count
+                   << ", total = " << totals.total_ns / 1e9 << " s"
+                   << ", mean = " << totals.total_ns / totals.count << " ns"
+                   << ", p50 < " << percentile(totals, 0.5) << " ns"
+                   << ", p99 < " << percentile(totals, 0.99) << " ns\n";
+            }
+        }
+
+        void report(const std::string &title, bool overlapped) {
+            const char* json_path = std::getenv("PLACER_STATS_JSON");
+            if (json_path != nullptr && *json_path != '\0') {
+                std::ofstream os{ json_path, std::ios::out | std::ios::app };
+                report(os, title, report_format::json, overlapped);
+            }
+            else {
+                report(std::cerr, title, report_format::text, overlapped);
+            }
+        }
+
+    }
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,174 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#pragma once
+
+// Counters, timers and latency histograms for the placers. Everything below, including the
+// call sites, compiles to nothing unless PLACER_ENABLE_STATS is defined.
+
+#define PLACER_STATS_CONCAT_IMPL(A, B) A##B
+#define PLACER_STATS_CONCAT(A, B) PLACER_STATS_CONCAT_IMPL(A, B)
+
+#ifdef PLACER_ENABLE_STATS
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#define PLACER_STATS_COUNTERS(X) \
+    X(random_moves)              \
+    X(random_accepted)           \
+    X(sa_moves)                  \
+    X(sa_accepted)               \
+    X(sa_temperatures)           \
+    X(swap_evaluations)          \
+    X(net_bbox_rescans)          \
+    X(qp_partitions)             \
+    X(qp_atoms)
+
+#define PLACER_STATS_TIMERS(X)   \
+    X(random_placement)          \
+    X(simulated_annealing)       \
+    X(parallel_simulated_annealing) \
+    X(parallel_tempering)        \
+    X(sa_temperature)            \
+    X(psa_batch)                 \
+    X(quadratic_placement)       \
+    X(qp_level)                  \
+    X(qp_partition)              \
+    X(qp_solve)                  \
+    X(legalization)
+
+namespace Utils {
+
+    namespace stats {
+
+#define PLACER_STATS_ENUM(NAME) NAME,
+        enum class counter { PLACER_STATS_COUNTERS(PLACER_STATS_ENUM) num_counters };
+        enum class timer { PLACER_STATS_TIMERS(PLACER_STATS_ENUM) num_timers };
+#undef PLACER_STATS_ENUM
+
+        constexpr std::size_t num_counters = static_cast<std::size_t>(counter::num_counters);
+        constexpr std::size_t num_timers = static_cast<std::size_t>(timer::num_timers);
+        constexpr std::size_t num_buckets = 48;
+
+        // Only the owning thread adds to a shard, but report() clears it concurrently, so every
+        // update is a relaxed read-modify-write.
+        struct timer_slot {
+            std::atomic<std::uint64_t> count;
+            std::atomic<std::uint64_t> total_ns;
+            std::array<std::atomic<std::uint64_t>, num_buckets> buckets;
+        };
+
+        struct shard {
+            std::array<std::atomic<std::uint64_t>, num_counters> counters;
+            std::array<timer_slot, num_timers> timers;
+        };
+
+        shard &local_shard();
+
+        inline void bump(std::atomic<std::uint64_t> &value, std::uint64_t n) {
+            value.fetch_add(n, std::memory_order_relaxed);
+        }
+
+        inline void add(counter c, std::uint64_t n) {
+            bump(local_shard().counters[static_cast<std::size_t>(c)], n);
+        }
+
+        void record(timer t, std::uint64_t ns);
+
+        class scoped_timer {
+
+        public:
+
+            explicit scoped_timer(timer t)
+                :m_timer{ t },
+                m_start{ std::chrono::steady_clock::now() }
+            {}
+
+            ~scoped_timer() {
+                auto elapsed = std::chrono::steady_clock::now() - m_start;
+                record(m_timer, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+            }
+
+            scoped_timer(const scoped_timer&) = delete;
+            scoped_timer &operator=(const scoped_timer&) = delete;
+
+        private:
+
+            timer m_timer;
+            std::chrono::steady_clock::time_point m_start;
+
+        };
+
+        enum class report_format { text, json };
+
+        // Sums every shard, writes the result and clears the shards for the next report. Overlapped
+        // reports are flagged, since their numbers include other placer calls.
+        void report(std::ostream &os, const std::string &title, report_format format, bool overlapped = false);
+
+        // Text to std::cerr, or one JSON object per line appended to $PLACER_STATS_JSON when set.
+        void report(const std::string &title, bool overlapped = false);
+
+        struct report_scope_id {
+            std::uint64_t generation;
+            bool overlapped;
+        };
+
+        report_scope_id begin_report_scope();
+
+        // Whether another report scope ran at any point between begin and end.
+        bool end_report_scope(const report_scope_id &id);
+
+        // Times the enclosing placer call, then reports everything collected since the last report.
+        // Shards belong to threads rather than to placer calls, so a report only describes its own
+        // placer when no other placer runs at the same time; otherwise it is marked as overlapped.
+        class scoped_report {
+
+        public:
+
+            scoped_report(timer t, const char* title)
+                :m_timer{ t },
+                m_title{ title },
+                m_scope{ begin_report_scope() },
+                m_start{ std::chrono::steady_clock::now() }
+            {}
+
+            ~scoped_report() {
+                auto elapsed = std::chrono::steady_clock::now() - m_start;
+                record(m_timer, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+                report(m_title, end_report_scope(m_scope));
+            }
+
+            scoped_report(const scoped_report&) = delete;
+            scoped_report &operator=(const scoped_report&) = delete;
+
+        private:
+
+            timer m_timer;
+            const char* m_title;
+            report_scope_id m_scope;
+            std::chrono::steady_clock::time_point m_start;
+
+        };
+
+    }
+
+}
+
+#define PLACER_STATS_ADD(NAME, N) ::Utils::stats::add(::Utils::stats::counter::NAME, (N))
+#define PLACER_STATS_TIMER(NAME) \
+    ::Utils::stats::scoped_timer PLACER_STATS_CONCAT(placer_stats_timer_, __LINE__){ ::Utils::stats::timer::NAME }
+#define PLACER_STATS_REPORT_SCOPE(NAME) \
+    ::Utils::stats::scoped_report PLACER_STATS_CONCAT(placer_stats_report_, __LINE__){ ::Utils::stats::timer::NAME, #NAME }
+
+#else
+
+#define PLACER_STATS_ADD(NAME, N) ((void)0)
+#define PLACER_STATS_TIMER(NAME) ((void)0)
+#define PLACER_STATS_REPORT_SCOPE(NAME) ((void)0)
+
+#endif
\ No newline at end of file
@@ -0,0 +1,138 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#include "thread_pool.h"
+
+namespace Utils {
+
+    namespace impl {
+
+        thread_local const thread_pool* current_pool = nullptr;
+        thread_local std::size_t current_queue = 0;
+
+    }
+
+    thread_pool::thread_pool(std::size_t num_threads)
+        :m_num_queued{ 0 },
+        m_stop{ false }
+    {
+        num_threads = std::max<std::size_t>(1, num_threads);
+        for (std::size_t i = 0; i < num_threads; ++i) {
+            m_queues.emplace_back(std::make_unique<task_queue>());
+        }
+        for (std::size_t i = 1; i < num_threads; ++i) {
+            m_workers.emplace_back([this, i]() { worker_loop(i); });
+        }
+    }
+
+    thread_pool::~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock{ m_sleep_mutex };
+            m_stop = true;
+        }
+        m_sleep_cv.notify_all();
+        for (std::thread &worker : m_workers) {
+            worker.join();
+        }
+    }
+
+    void thread_pool::run(task_group &group, std::function<void()> func) {
+        ++group.m_pending;
+        ++m_num_queued;
+        {
+            task_queue &queue = *m_queues[queue_index()];
+            std::lock_guard<std::mutex> lock{ queue.mutex };
+            queue.tasks.push_back(task{ std::move(func), &group });
+        }
+
+        if (!m_workers.empty()) {
+            { std::lock_guard<std::mutex> lock{ m_sleep_mutex }; }
+            m_sleep_cv.notify_one();
+        }
+    }
+
+    void thread_pool::wait(task_group &group) {
+        std::size_t self = queue_index();
+        task t;
+        while (group.m_pending > 0) {
+            if (try_pop(self, t)) {
+                execute(t);
+                continue;
+            }
+
+            // Nothing left to help with: sleep until a task is queued or the group's last task ends
+            std::unique_lock<std::mutex> lock{ m_sleep_mutex };
+            m_sleep_cv.wait(lock, [&]() { return group.m_pending == 0 || m_num_queued > 0; });
+        }
+
+        if (group.m_error) {
+            std::exception_ptr error = group.m_error;
+            group.m_error = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+    std::size_t thread_pool::queue_index() const {
+        return impl::current_pool == this ? impl::current_queue : 0;
+    }
+
+    bool thread_pool::try_pop(std::size_t self, task &out) {
+        if (m_num_queued == 0) return false;
+
+        {
+            task_queue &queue = *m_queues[self];
+            std::lock_guard<std::mutex> lock{ queue.mutex };
+            if (!queue.tasks.empty()) {
+                out = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+                --m_num_queued;
+                return true;
+            }
+        }
+
+        for (std::size_t i = 1; i < m_queues.size(); ++i) {
+            task_queue &victim = *m_queues[(self + i) % m_queues.size()];
+            std::lock_guard<std::mutex> lock{ victim.mutex };
+            if (!victim.tasks.empty()) {
+                out = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                --m_num_queued;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void thread_pool::execute(task &t) {
+        try {
+            t.func();
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock{ t.group->m_error_mutex };
+            if (!t.group->m_error) t.group->m_error = std::current_exception();
+        }
+        if (--t.group->m_pending == 0) {
+            { std::lock_guard<std::mutex> lock{ m_sleep_mutex }; }
+            m_sleep_cv.notify_all();
+        }
+    }
+
+    void thread_pool::worker_loop(std::size_t idx) {
+        impl::current_pool = this;
+        impl::current_queue = idx;
+
+        task t;
+        while (true) {
+            if (try_pop(idx, t)) {
+                execute(t);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock{ m_sleep_mutex };
+            m_sleep_cv.wait(lock, [&]() { return m_stop || m_num_queued > 0; });
+            if (m_stop) return;
+        }
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,100 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Utils {
+
+    // Work-stealing pool. Each worker owns a deque; it pops its own tasks LIFO and steals
+    // from the other deques FIFO when idle. The thread calling wait() executes tasks too, so
+    // a pool of size 1 runs everything inline on the caller, and blocks once there is nothing
+    // left for it to run.
+    class thread_pool {
+
+    public:
+
+        class task_group {
+
+            friend class thread_pool;
+
+        public:
+
+            task_group()
+                :m_pending{ 0 }
+            {}
+
+            task_group(const task_group&) = delete;
+            task_group &operator=(const task_group&) = delete;
+
+        private:
+
+            std::atomic<std::size_t> m_pending;
+            std::mutex m_error_mutex;
+            std::exception_ptr m_error;
+
+        };
+
+        explicit thread_pool(std::size_t num_threads);
+        ~thread_pool();
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool &operator=(const thread_pool&) = delete;
+
+        inline std::size_t size() const { return m_workers.size() + 1; }
+
+        void run(task_group &group, std::function<void()> func);
+        void wait(task_group &group);
+
+        template <typename Func>
+        void parallel_for(std::size_t begin, std::size_t end, Func &&func) {
+            if (begin >= end) return;
+
+            std::size_t chunk = std::max<std::size_t>(1, (end - begin) / (size() * 4));
+            task_group group;
+            for (std::size_t i = begin; i < end; i += chunk) {
+                std::size_t last = std::min(end, i + chunk);
+                run(group, [&func, i, last]() {
+                    for (std::size_t j = i; j < last; ++j) func(j);
+                });
+            }
+            wait(group);
+        }
+
+    private:
+
+        struct task {
+            std::function<void()> func;
+            task_group* group;
+        };
+
+        struct task_queue {
+            std::mutex mutex;
+            std::deque<task> tasks;
+        };
+
+        std::size_t queue_index() const;
+        bool try_pop(std::size_t self, task &out);
+        void execute(task &t);
+        void worker_loop(std::size_t idx);
+
+        std::vector<std::unique_ptr<task_queue>> m_queues;
+        std::vector<std::thread> m_workers;
+        std::atomic<std::size_t> m_num_queued;
+        std::atomic<bool> m_stop;
+        std::mutex m_sleep_mutex;
+        std::condition_variable m_sleep_cv;
+
+    };
+
+}
\ No newline at end of file
@@ -0,0 +1,138 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#include "trace.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace Utils {
+
+    namespace trace {
+
+        std::atomic<bool> tracing{ false };
+
+        namespace {
+
+            struct event {
+                const char* name;
+                std::uint64_t begin_ns;
+                std::uint64_t end_ns;
+                const char* arg_name;
+                double arg_value;
+            };
+
+            // Each thread appends to its own buffer. The lock is only ever contended by stop().
+            struct thread_buffer {
+                std::uint32_t tid;
+                std::mutex mutex;
+                std::vector<event> events;
+            };
+
+            struct registry {
+                std::mutex mutex;
+                std::vector<std::unique_ptr<thread_buffer>> buffers;
+                std::uint64_t origin_ns = 0;
+            };
+
+            registry &get_registry() {
+                static registry instance;
+                return instance;
+            }
+
+            thread_buffer &local_buffer() {
+                thread_local thread_buffer* local = nullptr;
+                if (local == nullptr) {
+                    registry &reg = get_registry();
+                    std::lock_guard<std::mutex> lock{ reg.mutex };
+                    reg.buffers.emplace_back(std::make_unique<thread_buffer>());
+                    local = reg.buffers.back().get();
+                    local->tid = static_cast<std::uint32_t>(reg.buffers.size() - 1);
+                }
+                return *local;
+            }
+
+            void write_trace(std::ostream &os, registry &reg) {
+                os << "{\"traceEvents\":[";
+                bool first = true;
+                os << std::fixed << std::setprecision(3);
+                for (const auto &buffer : reg.buffers) {
+                    std::lock_guard<std::mutex> lock{ buffer->mutex };
+                    os << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+                       << ",\"args\":{\"name\":\"thread " << buffer->tid << "\"}}";
+                    first = false;
+
+                    for (const event &e : buffer->events) {
+                        os << ",\n{\"name\":\"" << e.name << "\",\"cat\":\"placer\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+                           << ",\"ts\":" << static_cast<std::int64_t>(e.begin_ns - reg.origin_ns) / 1e3 << ",\"dur\":" << (e.end_ns - e.begin_ns) / 1e3;
+                        if (e.arg_name != nullptr) {
+                            os << ",\"args\":{\"" << e.arg_name << "\":" << std::defaultfloat << e.arg_value << std::fixed << "}";
+                        }
+                        os << "}";
+                    }
+                    buffer->events.clear();
+                }
+                os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+            }
+
+            // Traces the whole process when $PLACER_TRACE names an output file.
+            struct environment_session {
+                environment_session() {
+                    const char* path = std::getenv("PLACER_TRACE");
+                    if (path != nullptr && *path != '\0') {
+                        filepath = path;
+                        start();
+                    }
+                }
+
+                ~environment_session() {
+                    if (!filepath.empty() && enabled()) {
+                        try {
+                            stop(filepath);
+                        }
+                        catch (...) {}
+                    }
+                }
+
+                std::string filepath;
+            };
+
+            environment_session session;
+
+        }
+
+        void start() {
+            registry &reg = get_registry();
+            std::lock_guard<std::mutex> lock{ reg.mutex };
+            for (const auto &buffer : reg.buffers) {
+                std::lock_guard<std::mutex> buffer_lock{ buffer->mutex };
+                buffer->events.clear();
+            }
+            reg.origin_ns = now_ns();
+            tracing.store(true, std::memory_order_relaxed);
+        }
+
+        void stop(const std::string &filepath) {
+            tracing.store(false, std::memory_order_relaxed);
+
+            registry &reg = get_registry();
+            std::lock_guard<std::mutex> lock{ reg.mutex };
+            std::ofstream os{ filepath };
+            if (!os) throw std::runtime_error{ "cannot open trace file " + filepath };
+            write_trace(os, reg);
+        }
+
+        void record(const char* name, std::uint64_t begin_ns, std::uint64_t end_ns, const char* arg_name, double arg_value) {
+            thread_buffer &buffer = local_buffer();
+            std::lock_guard<std::mutex> lock{ buffer.mutex };
+            buffer.events.push_back(event{ name, begin_ns, end_ns, arg_name, arg_value });
+        }
+
+    }
+
+}
\ No newline at end of file
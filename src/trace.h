@@ -0,0 +1,75 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#pragma once
+
+// Timeline spans of the placement stages, written as a Chrome trace-event JSON file that loads in
+// chrome://tracing and ui.perfetto.dev. Tracing is switched on at runtime, either by setting
+// $PLACER_TRACE to the output path, in which case the trace is written at exit, or through
+// start() and stop(). While it is off a span costs one relaxed load.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#define PLACER_TRACE_CONCAT_IMPL(A, B) A##B
+#define PLACER_TRACE_CONCAT(A, B) PLACER_TRACE_CONCAT_IMPL(A, B)
+
+#define PLACER_TRACE_SPAN(NAME) \
+    ::Utils::trace::scoped_span PLACER_TRACE_CONCAT(placer_trace_span_, __LINE__){ NAME }
+#define PLACER_TRACE_SPAN_ARG(NAME, ARG, VALUE) \
+    ::Utils::trace::scoped_span PLACER_TRACE_CONCAT(placer_trace_span_, __LINE__){ NAME, ARG, static_cast<double>(VALUE) }
+
+namespace Utils {
+
+    namespace trace {
+
+        extern std::atomic<bool> tracing;
+
+        inline bool enabled() { return tracing.load(std::memory_order_relaxed); }
+
+        // Starts collecting spans, dropping any collected before.
+        void start();
+
+        // Stops collecting and writes every span collected since start(). Spans still open on
+        // other threads are lost, so call it once the placers have returned.
+        void stop(const std::string &filepath);
+
+        void record(const char* name, std::uint64_t begin_ns, std::uint64_t end_ns, const char* arg_name, double arg_value);
+
+        inline std::uint64_t now_ns() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        class scoped_span {
+
+        public:
+
+            explicit scoped_span(const char* name, const char* arg_name = nullptr, double arg_value = 0.0)
+                :m_name{ enabled() ? name : nullptr },
+                m_arg_name{ arg_name },
+                m_arg_value{ arg_value },
+                m_begin_ns{ m_name != nullptr ? now_ns() : 0 }
+            {}
+
+            ~scoped_span() {
+                if (m_name != nullptr) record(m_name, m_begin_ns, now_ns(), m_arg_name, m_arg_value);
+            }
+
+            scoped_span(const scoped_span&) = delete;
+            scoped_span &operator=(const scoped_span&) = delete;
+
+        private:
+
+            const char* m_name;
+            const char* m_arg_name;
+            double m_arg_value;
+            std::uint64_t m_begin_ns;
+
+        };
+
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#include <cstddef>
+#include <string>
+
+#include "binary_netlist.h"
+#include "blif_reader.h"
+#include "check.h"
+#include "flat_netlist.h"
+
+using namespace Utils;
+
+template <typename Port>
+std::size_t port_index(const Port &port, const Port* first) {
+    return &port - first;
+}
+
+bool same_netlist(const Netlist &lhs, const Netlist &rhs) {
+    FlatNetlist a{ lhs };
+    FlatNetlist b{ rhs };
+    if (a.num_atoms() != b.num_atoms() || a.opin_begin() != b.opin_begin() || a.ipin_begin() != b.ipin_begin()) return false;
+
+    for (FlatNetlist::id_type id = 0; id < a.num_atoms(); ++id) {
+        const Atom &x = a.get_atom(id);
+        const Atom &y = b.get_atom(id);
+        if (x.get_phase() != y.get_phase() || x.inputs().size() != y.inputs().size() || x.outputs().size() != y.outputs().size()) return false;
+
+        for (std::size_t k = 0; k < x.inputs().size(); ++k) {
+            const OPort* fx = x.get_iport(k).fanin();
+            const OPort* fy = y.get_iport(k).fanin();
+            if ((fx == nullptr) != (fy == nullptr)) return false;
+            if (fx == nullptr) continue;
+            if (a.atom_id(fx->get_atom()) != b.atom_id(fy->get_atom()) ||
+                port_index(*fx, &*fx->get_atom().begin_outputs()) != port_index(*fy, &*fy->get_atom().begin_outputs())) {
+                return false;
+            }
+        }
+        for (std::size_t k = 0; k < x.outputs().size(); ++k) {
+            if (x.get_oport(k).size() != y.get_oport(k).size()) return false;
+        }
+    }
+    return true;
+}
+
+bool rejects(const std::string &contents) {
+    return Tests::rejects("corrupt.bin", contents, load_binary_netlist);
+}
+
+int main() {
+    Netlist random = random_netlist(10, 5, 300, 200, 4, 2, 3);
+    save_binary_netlist(random, "random.bin");
+    CHECK(same_netlist(random, load_binary_netlist("random.bin")));
+
+    Netlist blif = read_blif(TEST_DATA_DIR "/counter.blif");
+    save_binary_netlist(blif, "counter.bin");
+    Netlist loaded = load_binary_netlist("counter.bin");
+    CHECK(same_netlist(blif, loaded));
+    save_binary_netlist(loaded, "counter_again.bin");
+    CHECK(Tests::read_file("counter.bin") == Tests::read_file("counter_again.bin"));
+
+    const std::string valid = Tests::read_file("random.bin");
+    CHECK(!rejects(valid));
+    CHECK(rejects(valid.substr(0, valid.size() - sizeof(binary_pin))));
+    CHECK(rejects(valid + std::string(sizeof(binary_pin), '\0')));
+    CHECK(rejects(Tests::patched<std::uint64_t>(valid, offsetof(binary_netlist_header, num_sinks), std::uint64_t(1) << 61)));
+    CHECK(rejects(Tests::patched<std::uint64_t>(valid, offsetof(binary_netlist_header, num_luts), ~std::uint64_t(0))));
+
+    // Below the 32-bit port limit, but would reserve gigabytes of ports for every cell
+    CHECK(rejects(Tests::patched<std::uint64_t>(valid, offsetof(binary_netlist_header, max_inputs), std::uint64_t(1) << 31)));
+    CHECK(rejects(Tests::patched<std::uint64_t>(valid, offsetof(binary_netlist_header, max_outputs), std::uint64_t(1) << 31)));
+
+    // Moves the end of the first net past the end of every other one
+    binary_netlist_view view{ "random.bin" };
+    std::size_t net_offsets = sizeof(binary_netlist_header) + view.num_atoms() * sizeof(std::uint64_t);
+    CHECK(rejects(Tests::patched<std::uint64_t>(valid, net_offsets + sizeof(std::uint64_t), view.header().num_sinks + 1)));
+
+    return TEST_EXIT_CODE();
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include "blif_reader.h"
+#include "check.h"
+#include "placement.h"
+
+using namespace Utils;
+
+std::string read_error(const std::string &filepath, const std::string &contents) {
+    {
+        std::ofstream os{ filepath };
+        os << contents;
+    }
+    try {
+        read_blif(filepath);
+    }
+    catch (const std::runtime_error &e) {
+        return e.what();
+    }
+    return "";
+}
+
+bool contains(const std::string &text, const std::string &part) {
+    return text.find(part) != std::string::npos;
+}
+
+int main() {
+    Netlist netlist = read_blif(TEST_DATA_DIR "/counter.blif");
+    CHECK(netlist.num_ipins() == 2);
+    CHECK(netlist.num_opins() == 2);
+    CHECK(netlist.num_luts() == 2);
+    CHECK(netlist.num_ffs() == 2);
+
+    Atom &d0 = get<Netlist::LUT>(netlist, 0);
+    Atom &d1 = get<Netlist::LUT>(netlist, 1);
+    Atom &q0 = get<Netlist::FF>(netlist, 0);
+    Atom &q1 = get<Netlist::FF>(netlist, 1);
+    OPort &en = get<IPin>(netlist, 0).get_oport();
+    OPort &rst = get<IPin>(netlist, 1).get_oport();
+
+    // The .exdc copy of d0 must not add a LUT or fanouts
+    CHECK(d0.get_iport(0).fanin() == &en);
+    CHECK(d0.get_iport(1).fanin() == &rst);
+    CHECK(d0.get_iport(2).fanin() == &q0.get_oport(0));
+    CHECK(!d0.get_iport(3).has_fanin());
+    CHECK(d1.get_iport(3).fanin() == &q1.get_oport(0));
+    CHECK(q0.get_iport(0).fanin() == &d0.get_oport(0));
+    CHECK(q1.get_iport(0).fanin() == &d1.get_oport(0));
+    CHECK(static_cast<Atom&>(get<OPin>(netlist, 1)).get_iport(0).fanin() == &q1.get_oport(0));
+    CHECK(en.size() == 2);
+    CHECK(q0.get_oport(0).size() == 3);
+
+    Chip chip{ 4, 4, netlist };
+    random_placement(chip, 1000);
+    simulated_annealing(chip, 4, 100, 1.0, 0.5);
+    Plan plan{ quadratic_placement(4, 4, netlist, 1, Plan::partitioning_method::bisection, 1) };
+    CHECK(plan.get_netlist().num_luts() == 2);
+
+    const std::string header = ".model m\n.inputs a\n.outputs b\n";
+    CHECK(contains(read_error("undriven.blif", header + ".latch c b\n.names a d\n1 1\n.end\n"), "undriven.blif:4: \"c\" is never driven"));
+    CHECK(contains(read_error("unknown.blif", header + ".latch c b\n.names a c\n1 1\n.clock clk\n.end\n"), "unknown.blif:7: unknown command .clock"));
+    CHECK(contains(read_error("combinational.blif", header + ".names a b\n1 1\n.end\n"), "at least one"));
+    CHECK(contains(read_error("no_inputs.blif", ".model m\n.outputs b\n.latch c b\n.names b c\n0 1\n.end\n"), "at least one"));
+    CHECK(contains(read_error("subckt.blif", header + ".subckt adder a=a b=b\n.end\n"), "subckt.blif:4: .subckt is not supported"));
+
+    return TEST_EXIT_CODE();
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#pragma once
+
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+#include "chip.h"
+
+namespace Tests {
+
+    inline int &num_failures() {
+        static int failures = 0;
+        return failures;
+    }
+
+    inline std::string read_file(const std::string &filepath) {
+        std::ifstream is{ filepath, std::ios::binary };
+        return std::string{ std::istreambuf_iterator<char>{ is }, std::istreambuf_iterator<char>{} };
+    }
+
+    inline void write_file(const std::string &filepath, const std::string &contents) {
+        std::ofstream os{ filepath, std::ios::binary };
+        os << contents;
+    }
+
+    // Copy of contents with the bytes of value written over those at offset
+    template <typename T>
+    std::string patched(std::string contents, std::size_t offset, T value) {
+        contents.replace(offset, sizeof(T), reinterpret_cast<const char*>(&value), sizeof(T));
+        return contents;
+    }
+
+    // Writes contents to filepath and tells whether load refuses it with a std::runtime_error
+    template <typename Load>
+    bool rejects(const std::string &filepath, const std::string &contents, Load &&load) {
+        write_file(filepath, contents);
+        try {
+            load(filepath);
+        }
+        catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    }
+
+    // The cached per-net bboxes must add up to what a placement rebuilt from scratch gives.
+    inline bool bbox_consistent(const Chip &chip) {
+        Chip rebuilt = chip.clone();
+        rebuilt.restore_sites(chip.sites());
+        return rebuilt.get_bbox() == chip.get_bbox();
+    }
+
+}
+
+#define CHECK(COND) \
+    if (!(COND)) { std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #COND "\n"; ++::Tests::num_failures(); }
+
+#define TEST_EXIT_CODE() (::Tests::num_failures() == 0 ? 0 : 1)
\ No newline at end of file
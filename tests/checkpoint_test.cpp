@@ -0,0 +1,118 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "check.h"
+#include "move_generator.h"
+#include "placement.h"
+
+using namespace Utils;
+
+template <typename T>
+bool rejects(const std::string &contents, std::size_t offset, T value) {
+    return Tests::rejects("corrupt.ckpt", Tests::patched(contents, offset, value), load_checkpoint);
+}
+
+int main() {
+    Netlist netlist = random_netlist(10, 5, 800, 800, 3, 3, 2);
+    Chip base{ 45, 45, netlist };
+    checkpoint_options checkpoint{ "placement.ckpt", std::chrono::milliseconds{ 0 } };
+
+    Chip random = base.clone();
+    Chip random_split = base.clone();
+    Chip random_resumed = base.clone();
+    random_placement(random, 40000);
+    random_placement(random_split, 17000, checkpoint);
+    resume_random_placement(random_resumed, 40000, checkpoint);
+    CHECK(random_resumed.sites() == random.sites());
+    CHECK(random_resumed.get_bbox() == random.get_bbox());
+
+    Chip annealed = base.clone();
+    Chip annealed_split = base.clone();
+    Chip annealed_resumed = base.clone();
+    simulated_annealing(annealed, 6, 4000, 5.0, 0.8);
+    simulated_annealing(annealed_split, 2, 4000, 5.0, 0.8, checkpoint);
+    anneal_checkpoint mid = load_checkpoint(checkpoint.filepath);
+    resume_simulated_annealing(annealed_resumed, 6, 4000, 0.8, checkpoint);
+    CHECK(annealed_resumed.sites() == annealed.sites());
+    CHECK(annealed_resumed.get_bbox() == annealed.get_bbox());
+
+    // Advances the checkpoint part way into the third temperature the way the annealer would,
+    // so resuming has to pick up in the middle of it
+    Chip annealed_mid = base.clone();
+    annealed_mid.restore_sites(mid.sites);
+    impl::move_generator moves{ annealed_mid };
+    Chip::pending_swap pending;
+    for (int j = 0; j < 1500; ++j) {
+        const Atom &atom = moves.atom(mid.engine);
+        std::int64_t delta = annealed_mid.evaluate_swap(atom, moves.site(mid.engine), pending);
+        if (impl::metropolis_accept(delta, mid.temperature, mid.engine)) annealed_mid.commit(pending);
+    }
+    mid.move = 1500;
+    mid.sites = annealed_mid.sites();
+    mid.bbox = annealed_mid.get_bbox();
+    save_checkpoint(mid, checkpoint.filepath);
+    CHECK(load_checkpoint(checkpoint.filepath).move == 1500);
+    resume_simulated_annealing(annealed_mid, 6, 4000, 0.8, checkpoint);
+    CHECK(annealed_mid.sites() == annealed.sites());
+    CHECK(annealed_mid.get_bbox() == annealed.get_bbox());
+
+    mid.move = 4000;
+    save_checkpoint(mid, checkpoint.filepath);
+    bool past_end_rejected = false;
+    try {
+        Chip chip = base.clone();
+        resume_simulated_annealing(chip, 6, 4000, 0.8, checkpoint);
+    }
+    catch (const std::runtime_error&) {
+        past_end_rejected = true;
+    }
+    CHECK(past_end_rejected);
+
+    // The last checkpoint of an adaptive anneal is its final state, so resuming it changes nothing
+    anneal_schedule schedule;
+    schedule.moves_per_atom = 0.2;
+    Chip adaptive = base.clone();
+    Chip adaptive_resumed = base.clone();
+    simulated_annealing(adaptive, schedule, 5, checkpoint);
+    anneal_checkpoint state = load_checkpoint(checkpoint.filepath);
+    CHECK(state.kind == checkpoint_kind::adaptive_annealing);
+    CHECK(state.sites == adaptive.sites());
+    CHECK(state.bbox == adaptive.get_bbox());
+    resume_simulated_annealing(adaptive_resumed, schedule, checkpoint);
+    CHECK(adaptive_resumed.sites() == adaptive.sites());
+
+    bool mismatch_rejected = false;
+    try {
+        Chip chip = base.clone();
+        resume_random_placement(chip, 10, checkpoint);
+    }
+    catch (const std::runtime_error&) {
+        mismatch_rejected = true;
+    }
+    CHECK(mismatch_rejected);
+
+    const std::string valid = Tests::read_file(checkpoint.filepath);
+    CHECK(!rejects(valid, 0, valid[0]));
+    CHECK(rejects(valid, offsetof(checkpoint_header, num_engine_words), std::uint64_t(1) << 40));
+    CHECK(rejects(valid, offsetof(checkpoint_header, num_sites), std::uint64_t(1) << 40));
+    CHECK(rejects(valid, offsetof(checkpoint_header, width), std::uint64_t(1) << 40));
+    CHECK(rejects(valid.substr(0, valid.size() - 4), 0, valid[0]));
+
+    CHECK(rejects(valid, offsetof(checkpoint_header, kind), std::uint32_t(7)));
+    CHECK(rejects(valid, offsetof(checkpoint_header, move), std::int64_t(1)));
+    CHECK(rejects(valid, offsetof(checkpoint_header, temperature), std::numeric_limits<double>::quiet_NaN()));
+    CHECK(rejects(valid, offsetof(checkpoint_header, temperature), std::numeric_limits<double>::infinity()));
+    CHECK(rejects(valid, offsetof(checkpoint_header, temperature), 0.0));
+    CHECK(rejects(valid, offsetof(checkpoint_header, temperature), -1.0));
+    CHECK(rejects(valid, offsetof(checkpoint_header, range_limit), std::int64_t(0)));
+    CHECK(rejects(valid, offsetof(checkpoint_header, range_limit), std::int64_t(46)));
+    CHECK(!rejects(valid, offsetof(checkpoint_header, range_limit), std::int64_t(45)));
+    CHECK(rejects(valid, offsetof(checkpoint_header, num_stalled), std::uint64_t(state.iteration + 1)));
+
+    return TEST_EXIT_CODE();
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#include <random>
+
+#include "check.h"
+#include "placement.h"
+
+using namespace Utils;
+
+int main() {
+    Netlist netlist = random_netlist(10, 5, 600, 600, 4, 3, 2);
+    Chip chip{ 40, 40, netlist };
+
+    std::mt19937 eng{ 11 };
+    std::bernoulli_distribution type_dist;
+    std::uniform_int_distribution<std::size_t> idx_dist{ 0, chip.get_width() * chip.get_height() / 2 - 1 };
+    std::uniform_int_distribution<std::size_t> lut_dist{ 0, netlist.num_luts() - 1 };
+    std::uniform_int_distribution<std::size_t> ff_dist{ 0, netlist.num_ffs() - 1 };
+
+    for (int i = 0; i < 20000; ++i) {
+        const Atom &atom = type_dist(eng) ? static_cast<const Atom&>(get<Netlist::LUT>(netlist, lut_dist(eng))) :
+                                            static_cast<const Atom&>(get<Netlist::FF>(netlist, ff_dist(eng)));
+        std::size_t idx = idx_dist(eng);
+
+        std::int64_t before = chip.get_bbox();
+        Chip::pending_swap move;
+        std::int64_t delta = chip.evaluate_swap(atom, idx, move);
+        CHECK(chip.get_bbox() == before);
+        CHECK(chip.evaluate_swap(atom, idx) == delta);
+
+        // Committing the evaluated swap must land where the evaluate-and-apply wrapper would
+        if (i % 2 == 0) {
+            Chip swapped = chip.clone();
+            swapped.swap(atom, idx);
+            chip.commit(move);
+            CHECK(chip.sites() == swapped.sites());
+            CHECK(chip.get_bbox() == swapped.get_bbox());
+        }
+        else {
+            chip.commit(move);
+        }
+        CHECK(chip.get_bbox() - before == delta);
+
+        // A wrong edge count only shows up in later deltas, so the total is rescanned as it goes
+        if (i % 1000 == 0) {
+            Chip rescanned = chip.clone();
+            CHECK(rescanned.recompute_bbox() == chip.get_bbox());
+        }
+    }
+
+    Chip rescanned = chip.clone();
+    CHECK(rescanned.recompute_bbox() == chip.get_bbox());
+
+    return TEST_EXIT_CODE();
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#include "check.h"
+#include "placement.h"
+
+int main() {
+    Netlist netlist = Utils::random_netlist(10, 5, 1500, 1500, 3, 3, 3);
+    Chip base{ 80, 80, netlist };
+
+    Chip random = base.clone();
+    Utils::random_placement(random, 50000);
+    CHECK(random.get_bbox() < base.get_bbox());
+    CHECK(Tests::bbox_consistent(random));
+
+    Chip annealed = base.clone();
+    Chip annealed_again = base.clone();
+    Utils::simulated_annealing(annealed, 8, 10000, 10.0, 0.7);
+    Utils::simulated_annealing(annealed_again, 8, 10000, 10.0, 0.7);
+    CHECK(annealed.sites() == annealed_again.sites());
+    CHECK(annealed.get_bbox() < base.get_bbox());
+    CHECK(Tests::bbox_consistent(annealed));
+
+    for (bool range_limited : { false, true }) {
+        Utils::anneal_schedule schedule;
+        schedule.moves_per_atom = 0.2;
+        schedule.range_limited = range_limited;
+
+        Chip adaptive = base.clone();
+        Chip adaptive_again = base.clone();
+        Utils::simulated_annealing(adaptive, schedule, 3);
+        Utils::simulated_annealing(adaptive_again, schedule, 3);
+        CHECK(adaptive.sites() == adaptive_again.sites());
+        CHECK(adaptive.get_bbox() < base.get_bbox());
+        CHECK(Tests::bbox_consistent(adaptive));
+    }
+
+    return TEST_EXIT_CODE();
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include "check.h"
+#include "netlist.h"
+
+using namespace Utils;
+using boost::property_tree::ptree;
+
+// Reads a dump back and checks it against the netlist: every atom in order with its phase, every
+// connected iport naming the oport that drives it and every oport naming its sinks in order.
+void check_dump(const Netlist &netlist, const std::string &filepath, netlist_ids ids) {
+    ptree tree;
+    boost::property_tree::read_json(filepath, tree);
+    CHECK(tree.size() == 4);
+
+    std::map<std::string, const Atom*> atoms;
+    std::map<std::string, const IPort*> iports;
+    std::map<std::string, const OPort*> oports;
+    std::vector<std::pair<const ptree*, const Atom*>> entries;
+
+    // Integer ids number the LUTs, FFs, IPins and OPins in that order
+    auto collect = [&](const char* name, const auto &range, std::uint64_t first_id) {
+        const ptree &section = tree.get_child(name);
+        CHECK(section.size() == static_cast<std::size_t>(range.size()));
+        if (section.size() != static_cast<std::size_t>(range.size())) return;
+
+        auto node = section.begin();
+        std::uint64_t id = first_id;
+        for (const Atom &atom : range) {
+            CHECK(atoms.emplace(node->first, &atom).second);
+            if (ids == netlist_ids::integer) CHECK(node->first == std::to_string(id));
+            CHECK(node->second.get<std::string>("phase") == std::to_string(atom.get_phase()));
+
+            const ptree &in = node->second.get_child("iports");
+            const ptree &out = node->second.get_child("oports");
+            CHECK(in.size() == atom.inputs().size() && out.size() == atom.outputs().size());
+            if (in.size() == atom.inputs().size() && out.size() == atom.outputs().size()) {
+                auto iport = atom.begin_inputs();
+                for (const auto &port : in) CHECK(iports.emplace(port.first, iport++).second);
+                auto oport = atom.begin_outputs();
+                for (const auto &port : out) CHECK(oports.emplace(port.first, oport++).second);
+                entries.emplace_back(&node->second, &atom);
+            }
+            ++node;
+            ++id;
+        }
+    };
+
+    std::uint64_t num_cells = netlist.num_luts() + netlist.num_ffs();
+    collect("LUTs", netlist.luts(), 0);
+    collect("FFs", netlist.ffs(), netlist.num_luts());
+    collect("IPins", netlist.ipins(), num_cells);
+    collect("OPins", netlist.opins(), num_cells + netlist.num_ipins());
+    CHECK(entries.size() == num_cells + netlist.num_ipins() + netlist.num_opins());
+
+    auto names = [](const auto &ports, const std::string &id, const auto* port) {
+        auto found = ports.find(id);
+        return found != ports.end() && found->second == port;
+    };
+
+    for (const auto &entry : entries) {
+        const Atom &atom = *entry.second;
+
+        auto iport = atom.begin_inputs();
+        for (const auto &port : entry.first->get_child("iports")) {
+            if (iport->has_fanin()) {
+                CHECK(port.second.size() == 1 && names(oports, port.second.front().second.data(), iport->fanin()));
+            }
+            else {
+                CHECK(port.second.empty() && port.second.data().empty());
+            }
+            ++iport;
+        }
+
+        auto oport = atom.begin_outputs();
+        for (const auto &port : entry.first->get_child("oports")) {
+            CHECK(port.second.size() == oport->size());
+            if (port.second.size() == oport->size()) {
+                auto sink = oport->begin();
+                for (const auto &fanout : port.second) CHECK(names(iports, fanout.second.data(), *sink++));
+            }
+            ++oport;
+        }
+    }
+}
+
+int main() {
+    Netlist netlist = random_netlist(10, 5, 300, 200, 3, 2, 3);
+    for (netlist_ids ids : { netlist_ids::pointer, netlist_ids::integer }) {
+        dump_netlist(netlist, "netlist.json", ids);
+        check_dump(netlist, "netlist.json", ids);
+    }
+
+    // Integer ids depend only on the netlist, not on where it was allocated
+    Netlist again = random_netlist(10, 5, 300, 200, 3, 2, 3);
+    dump_netlist(again, "netlist_again.json", netlist_ids::integer);
+    CHECK(Tests::read_file("netlist.json") == Tests::read_file("netlist_again.json"));
+
+    return TEST_EXIT_CODE();
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#include <cstdio>
+#include <fstream>
+
+#include "check.h"
+#include "placement.h"
+
+std::size_t num_recorded_moves(const Chip &base, std::size_t num_swap_per_temperature, std::size_t num_threads) {
+    Chip chip = base.clone();
+    {
+        Utils::metric_consumer met{ "psa_iterations.bin", "psa_snapshots.txt" };
+        Utils::parallel_simulated_annealing(chip, 3, num_swap_per_temperature, 5.0, 0.8, num_threads, 1, &met);
+    }
+
+    std::ifstream is{ "psa_iterations.bin", std::ios::binary | std::ios::ate };
+    std::size_t size = static_cast<std::size_t>(is.tellg());
+    std::remove("psa_iterations.bin");
+    std::remove("psa_snapshots.txt");
+    return (size - sizeof(Utils::metric_file_header)) / sizeof(Utils::metric_record);
+}
+
+int main() {
+    Netlist netlist = Utils::random_netlist(10, 5, 2000, 2000, 3, 3, 3);
+    Chip base{ 100, 100, netlist };
+
+    for (std::size_t num_threads : { 1, 3, 4 }) {
+        Chip first = base.clone();
+        Chip second = base.clone();
+        Utils::parallel_simulated_annealing(first, 8, 20000, 20.0, 0.7, num_threads, 42);
+        Utils::parallel_simulated_annealing(second, 8, 20000, 20.0, 0.7, num_threads, 42);
+        CHECK(first.sites() == second.sites());
+        CHECK(first.get_bbox() == second.get_bbox());
+        CHECK(first.get_bbox() < base.get_bbox());
+        CHECK(Tests::bbox_consistent(first));
+
+        // Budgets that are not a multiple of the batch size still run exactly as many moves
+        for (std::size_t num_swap : { 1, 1000, 5001 }) {
+            CHECK(num_recorded_moves(base, num_swap, num_threads) == 3 * num_swap);
+        }
+    }
+
+    Chip tempered = Utils::parallel_tempering(base, 4, 5000, 0.5, 20.0, 3, 3, 7);
+    Chip tempered_again = Utils::parallel_tempering(base, 4, 5000, 0.5, 20.0, 3, 3, 7);
+    CHECK(tempered.sites() == tempered_again.sites());
+    CHECK(Tests::bbox_consistent(tempered));
+
+    return TEST_EXIT_CODE();
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#include <vector>
+
+#include "check.h"
+#include "placement.h"
+
+using namespace Utils;
+
+std::vector<double> coords(const Plan &plan, const Netlist &netlist) {
+    std::vector<double> values;
+    for (std::size_t i = 0; i < netlist.num_luts(); ++i) {
+        Plan::coord c = plan.get_coord(get<Netlist::LUT>(netlist, i));
+        values.push_back(c.x);
+        values.push_back(c.y);
+    }
+    for (std::size_t i = 0; i < netlist.num_ffs(); ++i) {
+        Plan::coord c = plan.get_coord(get<Netlist::FF>(netlist, i));
+        values.push_back(c.x);
+        values.push_back(c.y);
+    }
+    return values;
+}
+
+int main() {
+    Netlist netlist = random_netlist(10, 5, 1200, 1200, 3, 3, 3);
+    Chip random{ 70, 70, netlist };
+
+    for (Plan::partitioning_method method : { Plan::partitioning_method::bisection, Plan::partitioning_method::adaptive }) {
+        for (qp_solver solver : { qp_solver::direct, qp_solver::conjugate_gradient_jacobi, qp_solver::conjugate_gradient_ichol }) {
+            qp_options options;
+            options.solver = solver;
+            Plan plan = quadratic_placement(70, 70, netlist, 4, method, 3, nullptr, options);
+            std::vector<double> expected = coords(plan, netlist);
+            Chip legalized{ plan };
+            CHECK(legalized.get_bbox() < random.get_bbox());
+
+            // Partitions are solved independently and assigned in order, so the thread count must
+            // not change a single bit of the result
+            for (std::size_t num_threads : { 2, 4 }) {
+                options.num_threads = num_threads;
+                Plan threaded = quadratic_placement(70, 70, netlist, 4, method, 3, nullptr, options);
+                CHECK(coords(threaded, netlist) == expected);
+                CHECK(Chip{ threaded }.sites() == legalized.sites());
+            }
+        }
+    }
+
+    return TEST_EXIT_CODE();
+}
\ No newline at end of file
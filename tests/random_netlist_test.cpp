@@ -0,0 +1,29 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#include <string>
+
+#include "binary_netlist.h"
+#include "check.h"
+
+using namespace Utils;
+
+// The binary format stores every phase and connection, so equal files mean identical netlists
+std::string serialized(const Netlist &netlist) {
+    save_binary_netlist(netlist, "netlist.bin");
+    return Tests::read_file("netlist.bin");
+}
+
+int main() {
+    const std::string expected = serialized(parallel_random_netlist(10, 5, 3000, 2000, 3, 3, 3, 1, 7));
+    for (std::size_t num_threads : { 2, 3, 8 }) {
+        CHECK(serialized(parallel_random_netlist(10, 5, 3000, 2000, 3, 3, 3, num_threads, 7)) == expected);
+    }
+    CHECK(serialized(parallel_random_netlist(10, 5, 3000, 2000, 3, 3, 3, 2, 8)) != expected);
+
+    Netlist netlist = parallel_random_netlist(10, 5, 3000, 2000, 3, 3, 3, 4, 7);
+    CHECK(netlist.num_luts() == 3000 && netlist.num_ffs() == 2000);
+    CHECK(netlist.num_ipins() == 10 && netlist.num_opins() == 5);
+
+    return TEST_EXIT_CODE();
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+// (C) Copyright Shou Hao Ho   2018
+// Distributed under the MIT Software License (See accompanying LICENSE file)
+
+#include <atomic>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "check.h"
+#include "thread_pool.h"
+
+void test_parallel_for(Utils::thread_pool &pool) {
+    std::vector<std::size_t> values(10000, 0);
+    pool.parallel_for(0, values.size(), [&](std::size_t i) { values[i] = i; });
+
+    std::vector<std::size_t> expected(values.size());
+    std::iota(expected.begin(), expected.end(), 0);
+    CHECK(values == expected);
+}
+
+// Tasks that wait on their own groups exercise wait() from a worker while other groups run.
+void test_nested_groups(Utils::thread_pool &pool) {
+    std::atomic<std::size_t> sum{ 0 };
+    for (int round = 0; round < 50; ++round) {
+        pool.parallel_for(0, 16, [&](std::size_t i) {
+            pool.parallel_for(0, 64, [&](std::size_t j) { sum += i * j; });
+        });
+    }
+    CHECK(sum == 50 * (15 * 16 / 2) * (63 * 64 / 2));
+}
+
+void test_exception(Utils::thread_pool &pool) {
+    Utils::thread_pool::task_group group;
+    std::atomic<int> num_run{ 0 };
+    for (int i = 0; i < 32; ++i) {
+        pool.run(group, [&, i]() {
+            ++num_run;
+            if (i == 7) throw std::runtime_error{ "task failed" };
+        });
+    }
+
+    bool thrown = false;
+    try {
+        pool.wait(group);
+    }
+    catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(num_run == 32);
+}
+
+int main() {
+    for (std::size_t num_threads : { 1, 2, 4 }) {
+        Utils::thread_pool pool{ num_threads };
+        test_parallel_for(pool);
+        test_nested_groups(pool);
+        test_exception(pool);
+    }
+    return TEST_EXIT_CODE();
+}
\ No newline at end of file